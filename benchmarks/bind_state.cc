@@ -0,0 +1,55 @@
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+#include "ir.hh"
+
+constexpr uint32_t lines_per_state = 4;
+
+// synthetic pipelined module: every state covers a handful of lines and every line is an
+// instruction scope. binding time should grow linearly with the number of states
+int64_t bench_bind_state(uint32_t num_states) {
+    Context context;
+    auto module = std::make_shared<ModuleInfo>("bench");
+    context.add_module("bench", module);
+
+    auto *root = context.add_scope<Scope>(nullptr);
+    root->filename = context.intern("/tmp/bench.cc");
+    root->raw_filename = context.intern("bench.cc");
+    auto num_lines = num_states * lines_per_state;
+    for (auto line = 1u; line <= num_lines; line++) {
+        context.add_scope<Instruction>(root, line);
+    }
+
+    for (auto i = 0u; i < num_states; i++) {
+        auto name = "ap_CS_fsm_state" + std::to_string(i);
+        StateInfo info(name);
+        for (auto j = 0u; j < lines_per_state; j++) {
+            info.add_instruction("bench.cc", i * lines_per_state + j + 1);
+        }
+        module->state_infos.emplace(name, info);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    root->bind_state(*module);
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+}
+
+int main() {
+    // binding mutates the tree, so every run builds a fresh one. the median hides scheduler noise
+    constexpr uint32_t num_runs = 5;
+    for (auto num_states = 1000u; num_states <= 64000u; num_states *= 2) {
+        std::vector<int64_t> times;
+        for (auto i = 0u; i < num_runs; i++) {
+            times.emplace_back(bench_bind_state(num_states));
+        }
+        std::nth_element(times.begin(), times.begin() + num_runs / 2, times.end());
+        auto us = times[num_runs / 2];
+        std::cout << "states: " << num_states << "\tscopes: " << num_states * lines_per_state
+                  << "\ttime: " << us << " us\tper state: " << static_cast<double>(us) / num_states
+                  << " us" << std::endl;
+    }
+    return 0;
+}
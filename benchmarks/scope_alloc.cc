@@ -0,0 +1,157 @@
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <vector>
+
+#include "ir.hh"
+
+// count every heap allocation made by the process. the arena's upstream resource uses the
+// aligned overloads, so those are counted as well
+static std::atomic<uint64_t> num_allocations = 0;
+
+void *operator new(std::size_t size) {
+    num_allocations++;
+    if (auto *p = std::malloc(size)) return p;
+    throw std::bad_alloc();
+}
+
+void *operator new(std::size_t size, std::align_val_t align) {
+    num_allocations++;
+    auto alignment = static_cast<std::size_t>(align);
+    if (auto *p = std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t) noexcept { std::free(p); }
+void operator delete(void *p, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t, std::align_val_t) noexcept { std::free(p); }
+
+struct Stats {
+    uint64_t allocations;
+    int64_t us;
+};
+
+template <typename F>
+Stats measure(F &&f) {
+    auto allocations = num_allocations.load();
+    auto start = std::chrono::steady_clock::now();
+    f();
+    auto end = std::chrono::steady_clock::now();
+    return {num_allocations.load() - allocations,
+            std::chrono::duration_cast<std::chrono::microseconds>(end - start).count()};
+}
+
+// replica of the allocator before the arena: Context::add_scope made one heap node per scope and
+// kept the unique_ptrs in a vector, children lists were heap-backed std::vectors. data members
+// and copy() match Scope so that both sides do the same work
+class HeapContext;
+
+class HeapScope {
+public:
+    std::vector<HeapScope *> scopes;
+    Symbol filename = EMPTY_SYMBOL;
+    Symbol raw_filename = EMPTY_SYMBOL;
+    uint32_t line = 0;
+    std::vector<Symbol> state_ids;
+    Symbol instance_prefix = EMPTY_SYMBOL;
+
+    HeapScope *parent_scope;
+    ModuleInfo *module = nullptr;
+    HeapContext *context = nullptr;
+
+    explicit HeapScope(HeapScope *parent_scope) : parent_scope(parent_scope) {}
+
+    void add_scope(HeapScope *scope) {
+        scopes.emplace_back(scope);
+        scope->parent_scope = this;
+        scope->module = module;
+    }
+
+    [[nodiscard]] virtual HeapScope *copy() const;
+
+    virtual ~HeapScope() = default;
+
+private:
+    ScopeKind kind_ = ScopeKind::Block;
+};
+
+class HeapInstruction : public HeapScope {
+public:
+    HeapInstruction(HeapScope *parent_scope, uint32_t line) : HeapScope(parent_scope) {
+        this->line = line;
+    }
+
+    [[nodiscard]] HeapScope *copy() const override;
+};
+
+class HeapContext {
+public:
+    template <typename T, typename... Args>
+    T *add_scope(HeapScope *parent_scope, Args... args) {
+        auto entry = std::make_unique<T>(parent_scope, args...);
+        if (parent_scope) parent_scope->scopes.emplace_back(entry.get());
+        entry->context = this;
+        return reinterpret_cast<T *>(scopes_.emplace_back(std::move(entry)).get());
+    }
+
+private:
+    std::vector<std::unique_ptr<HeapScope>> scopes_;
+};
+
+// NOLINTNEXTLINE
+HeapScope *HeapScope::copy() const {
+    auto *new_scope = context->add_scope<HeapScope>(nullptr);
+    *new_scope = *this;
+    new_scope->scopes.clear();
+    for (auto const *s : scopes) {
+        auto *new_s = s->copy();
+        new_scope->add_scope(new_s);
+    }
+    return new_scope;
+}
+
+HeapScope *HeapInstruction::copy() const {
+    auto *new_scope = context->add_scope<HeapInstruction>(nullptr, line);
+    *new_scope = *this;
+    return new_scope;
+}
+
+// builds a tree and copies it the way merge_scope does, then tears everything down
+template <typename C, typename S, typename I>
+void build_and_copy(uint32_t num_blocks, uint32_t num_lines) {
+    C context;
+    auto *root = context.template add_scope<S>(nullptr);
+    for (auto i = 0u; i < num_blocks; i++) {
+        auto *block = context.template add_scope<S>(root);
+        for (auto line = 1u; line <= num_lines; line++) {
+            context.template add_scope<I>(block, line);
+        }
+    }
+    (void)root->copy();
+}
+
+void print(const char *name, uint64_t num_nodes, const Stats &stats) {
+    std::cout << name << "\tnodes: " << num_nodes << "\tallocations: " << stats.allocations
+              << "\ttime: " << stats.us << " us" << std::endl;
+}
+
+int main() {
+    constexpr uint32_t num_lines = 32;
+    for (auto num_blocks = 1000u; num_blocks <= 64000u; num_blocks *= 4) {
+        uint64_t num_nodes = 1 + num_blocks * (num_lines + 1);
+        auto heap = measure([=]() {
+            build_and_copy<HeapContext, HeapScope, HeapInstruction>(num_blocks, num_lines);
+        });
+        auto arena = measure(
+            [=]() { build_and_copy<Context, Scope, Instruction>(num_blocks, num_lines); });
+        print("heap ", num_nodes * 2, heap);
+        print("arena", num_nodes * 2, arena);
+    }
+    return 0;
+}
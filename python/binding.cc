@@ -1,4 +1,8 @@
+#include "future.hh"
 #include "ir.hh"
+#include "symbol_table.hh"
+#include "task.hh"
+#include "xrf.hh"
 #include "pybind11/pybind11.h"
 #include "pybind11/stl.h"
 
@@ -14,7 +18,9 @@ void bind_llvm(py::module &m) {
                 return module.getFunction(function_name);
             },
             py::return_value_policy::reference)
-        .def("get_optimized_functions", get_optimized_functions);
+        // loads every function body, even for lazily parsed modules
+        .def("get_optimized_functions", get_optimized_functions, py::arg("function_names"),
+             py::arg("num_threads") = 1);
 
     py::class_<llvm::Instruction, std::unique_ptr<llvm::Instruction, py::nodelete>>(m,
                                                                                     "Instruction")
@@ -37,9 +43,9 @@ void bind_llvm(py::module &m) {
 
 void bind_scope(py::module &m) {
     py::class_<Scope>(m, "Scope")
-        .def("serialize", &Scope::serialize)
-        .def("bind_state", &Scope::bind_state)
-        .def_readonly("instruction", &Scope::instruction);
+        .def("serialize",
+             py::overload_cast<const SerializationOptions &>(&Scope::serialize, py::const_))
+        .def("bind_state", &Scope::bind_state);
     py::class_<Context>(m, "Context")
         .def(py::init<>())
         .def("__getitem__", &Context::get_module)
@@ -47,38 +53,109 @@ void bind_scope(py::module &m) {
         .def("__contains__", &Context::has_module)
         .def("modules", [](Context &context) { return context.module_infos(); })
         .def("set_rtl_info", &Context::set_rtl_info)
+        .def(
+            "set_rtl_table",
+            [](Context &context, const py::buffer &table) {
+                auto info = table.request();
+                if (info.ndim != 1 || info.strides[0] != info.itemsize) {
+                    throw std::runtime_error("RTL table has to be a contiguous buffer");
+                }
+                std::string_view data(static_cast<const char *>(info.ptr),
+                                      static_cast<uint64_t>(info.size * info.itemsize));
+                py::gil_scoped_release release;
+                context.set_rtl_table(data);
+            },
+            py::arg("table"))
+        .def_property_readonly("filename_resolver", &Context::filename_resolver,
+                               py::return_value_policy::reference_internal)
         .def_readwrite("top_name", &Context::top_name);
 
+    py::class_<FilenameResolver>(m, "FilenameResolver")
+        .def_property_readonly("num_lookups", &FilenameResolver::num_lookups)
+        .def_property_readonly("num_files", &FilenameResolver::num_files)
+        .def_property_readonly("saved_syscalls", &FilenameResolver::saved_syscalls);
+
     py::class_<StateInfo>(m, "StateInfo")
         .def(py::init<std::string>())
-        .def("add_instr", &StateInfo::add_instruction);
+        .def("add_instr", &StateInfo::add_instruction)
+        .def_readonly("name", &StateInfo::name)
+        .def_property_readonly("instructions", [](const StateInfo &info) {
+            std::vector<std::pair<std::string, uint32_t>> res;
+            res.reserve(info.instructions.size());
+            for (auto const &[filename, line] : info.instructions) {
+                res.emplace_back(filename, line);
+            }
+            return res;
+        });
 
     py::class_<SerializationOptions>(m, "SerializationOptions")
         .def(py::init<>())
         .def("add_mapping", &SerializationOptions::add_mapping);
 
-    py::class_<SignalInfo>(m, "SignalInfo")
-        .def(py::init<std::string, uint32_t>())
-        .def_readonly("name", &SignalInfo::name)
-        .def_readonly("width", &SignalInfo::width);
-
     py::class_<ModuleInfo, std::shared_ptr<ModuleInfo>>(m, "ModuleInfo")
         .def(py::init<std::string>())
         .def_readonly("module_name", &ModuleInfo::module_name)
         .def_readwrite("state_infos", &ModuleInfo::state_infos)
-        .def_readwrite("signals", &ModuleInfo::signals)
         .def_readwrite("function", &ModuleInfo::function)
         .def_readwrite("instances", &ModuleInfo::instances)
         .def("add_instance", &ModuleInfo::add_instance);
 
-    m.def("reorganize_scopes", reorganize_scopes);
+    m.def("build_module_scopes", build_module_scopes, py::arg("context"), py::arg("modules"),
+          py::arg("num_threads") = 0, py::return_value_policy::reference,
+          py::call_guard<py::gil_scoped_release>());
+    m.def("parse_state_transitions", parse_state_transitions, py::arg("context"),
+          py::arg("directory"), py::arg("num_threads") = 0,
+          py::call_guard<py::gil_scoped_release>());
+    m.def("reorganize_scopes", reorganize_scopes, py::return_value_policy::reference,
+          py::call_guard<py::gil_scoped_release>());
     m.def("infer_dangling_scope_state", infer_dangling_scope_state);
     m.def("infer_function_arg", infer_function_arg);
+    // the module and everything returned from it can't be used afterwards
+    m.def("release_llvm_bitcode", release_llvm_bitcode, py::arg("context"), py::arg("module"),
+          py::call_guard<py::gil_scoped_release>());
     m.def("inject_function_args", inject_function_args);
+    m.def("write_symbol_table", write_symbol_table);
+    m.def("write_symbol_table_db", write_symbol_table_db);
+}
+
+void bind_task(py::module &m) {
+    py::class_<TaskGraph>(m, "TaskGraph")
+        .def(py::init<>())
+        .def(
+            "add_task",
+            [](TaskGraph &graph, const std::string &name, const py::function &function,
+               const std::vector<std::string> &inputs) {
+                // tasks run on worker threads, which have to take the GIL to call into Python.
+                // the function is only copied or destroyed while the GIL is held
+                graph.add_task(
+                    name,
+                    [function]() {
+                        py::gil_scoped_acquire acquire;
+                        function();
+                    },
+                    inputs);
+            },
+            py::arg("name"), py::arg("function"), py::arg("inputs") = std::vector<std::string>{})
+        .def("run", &TaskGraph::run, py::arg("num_threads") = 0,
+             py::call_guard<py::gil_scoped_release>())
+        .def_property_readonly("critical_path", &TaskGraph::critical_path)
+        .def_property_readonly("critical_path_time", &TaskGraph::critical_path_time)
+        .def_property_readonly("total_time", &TaskGraph::total_time)
+        .def("report", &TaskGraph::report);
 }
 
 PYBIND11_MODULE(vitis, m) {
     bind_llvm(m);
     bind_scope(m);
-    m.def("parse_llvm_bitcode", &parse_llvm_bitcode, py::return_value_policy::reference);
+    bind_task(m);
+    m.def("parse_llvm_bitcode", &parse_llvm_bitcode, py::arg("path"), py::arg("lazy") = false,
+          py::return_value_policy::reference, py::call_guard<py::gil_scoped_release>());
+    // every module has its own LLVM context, so several files can be parsed at the same time
+    bind_future<llvm::Module *>(m, "ModuleFuture");
+    m.def(
+        "parse_llvm_bitcode_async",
+        [](const std::string &path, bool lazy) {
+            return launch_async(&parse_llvm_bitcode, path, lazy);
+        },
+        py::arg("path"), py::arg("lazy") = false);
 }
\ No newline at end of file
@@ -0,0 +1,214 @@
+#include "cache.hh"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+
+#ifndef VERSION_INFO
+#define VERSION_INFO "dev"
+#endif
+
+namespace {
+constexpr std::string_view CACHE_MAGIC = "HGDBVITS";
+// entries of the same kind kept around, e.g. for runs with different options on the same inputs
+constexpr uint64_t MAX_CACHE_ENTRIES = 8;
+// temporary files older than this are left over from killed runs
+constexpr auto STALE_TEMP_AGE = std::chrono::hours(24);
+
+// 64-bit FNV-1a. good enough to detect changes in the inputs and cheap to compute
+class Hasher {
+public:
+    void update(const char *data, uint64_t size) {
+        for (uint64_t i = 0; i < size; i++) {
+            hash_ ^= static_cast<uint8_t>(data[i]);
+            hash_ *= 0x100000001b3ull;
+        }
+    }
+
+    void update(std::string_view value) {
+        update(value.data(), value.size());
+        // separator so that ("ab", "c") and ("a", "bc") hash differently
+        update("\0", 1);
+    }
+
+    [[nodiscard]] std::string hex() const {
+        std::stringstream ss;
+        ss << std::hex;
+        ss.width(16);
+        ss.fill('0');
+        ss << hash_;
+        return ss.str();
+    }
+
+private:
+    uint64_t hash_ = 0xcbf29ce484222325ull;
+};
+}  // namespace
+
+void BinaryWriter::write(uint32_t value) {
+    char bytes[4];
+    for (auto i = 0u; i < 4; i++) {
+        bytes[i] = static_cast<char>((value >> (i * 8)) & 0xFF);
+    }
+    buffer_.append(bytes, 4);
+}
+
+void BinaryWriter::write(std::string_view value) {
+    write(static_cast<uint32_t>(value.size()));
+    buffer_.append(value);
+}
+
+bool BinaryReader::read(uint32_t &value) {
+    if (pos_ + 4 > data_.size()) return false;
+    value = 0;
+    for (auto i = 0u; i < 4; i++) {
+        value |= static_cast<uint32_t>(static_cast<uint8_t>(data_[pos_ + i])) << (i * 8);
+    }
+    pos_ += 4;
+    return true;
+}
+
+bool BinaryReader::read(std::string &value) {
+    uint32_t size;
+    if (!read(size)) return false;
+    if (pos_ + size > data_.size()) return false;
+    value = data_.substr(pos_, size);
+    pos_ += size;
+    return true;
+}
+
+InputCache::InputCache(std::string directory, std::string kind)
+    : directory_(std::move(directory)), kind_(std::move(kind)) {}
+
+std::string InputCache::compute_key(const std::vector<std::string> &files,
+                                    const std::string &salt) const {
+    Hasher hasher;
+    hasher.update(VERSION_INFO);
+    hasher.update(std::to_string(CACHE_FORMAT_VERSION));
+    hasher.update(kind_);
+    hasher.update(salt);
+
+    std::vector<char> buffer(1 << 16);
+    for (auto const &filename : files) {
+        hasher.update(filename);
+        std::ifstream stream(filename, std::ios::binary);
+        if (!stream.is_open()) {
+            // missing files are part of the key as well
+            hasher.update("<missing>");
+            continue;
+        }
+        while (stream) {
+            stream.read(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+            hasher.update(buffer.data(), stream.gcount());
+        }
+        hasher.update("<eof>");
+    }
+    return hasher.hex();
+}
+
+std::optional<std::string> InputCache::load(const std::string &key) const {
+    if (!enabled()) return std::nullopt;
+    std::ifstream stream(entry_path(key), std::ios::binary);
+    if (!stream.is_open()) return std::nullopt;
+    std::stringstream ss;
+    ss << stream.rdbuf();
+    auto content = ss.str();
+    stream.close();
+    // mark the entry as recently used so that eviction keeps it
+    std::error_code ec;
+    std::filesystem::last_write_time(entry_path(key), std::filesystem::file_time_type::clock::now(),
+                                     ec);
+
+    // header is magic + format version
+    std::string_view view = content;
+    if (view.size() < CACHE_MAGIC.size() + 4 || view.substr(0, CACHE_MAGIC.size()) != CACHE_MAGIC) {
+        return std::nullopt;
+    }
+    uint32_t version;
+    BinaryReader version_reader(view.substr(CACHE_MAGIC.size(), 4));
+    if (!version_reader.read(version) || version != CACHE_FORMAT_VERSION) return std::nullopt;
+    return content.substr(CACHE_MAGIC.size() + 4);
+}
+
+void InputCache::store(const std::string &key, const std::string &payload) const {
+    if (!enabled()) return;
+    namespace fs = std::filesystem;
+    std::error_code ec;
+    fs::create_directories(directory_, ec);
+    if (ec) {
+        std::cerr << "Unable to create cache directory " << directory_ << ": " << ec.message()
+                  << std::endl;
+        return;
+    }
+
+    BinaryWriter header;
+    header.write(CACHE_FORMAT_VERSION);
+    auto path = entry_path(key);
+    // write to a temporary file first so that a concurrent or killed run never leaves a
+    // partially written entry behind. the name is unique per writer, otherwise two runs on the
+    // same inputs would write into the same temporary file
+    std::random_device random;
+    std::stringstream temp_name;
+    temp_name << path << '.' << ::getpid() << '.' << std::hex << random() << ".tmp";
+    auto temp_path = temp_name.str();
+    {
+        std::ofstream stream(temp_path, std::ios::binary | std::ios::trunc);
+        if (!stream.is_open()) return;
+        stream.write(CACHE_MAGIC.data(), static_cast<std::streamsize>(CACHE_MAGIC.size()));
+        stream.write(header.data().data(), static_cast<std::streamsize>(header.data().size()));
+        stream.write(payload.data(), static_cast<std::streamsize>(payload.size()));
+        if (!stream) {
+            stream.close();
+            fs::remove(temp_path, ec);
+            return;
+        }
+    }
+    fs::rename(temp_path, path, ec);
+    if (ec) {
+        fs::remove(temp_path, ec);
+        return;
+    }
+
+    evict();
+}
+
+void InputCache::evict() const {
+    // keys hash every option, so entries for the same inputs cannot be told apart from entries
+    // for other inputs. keep the most recently used entries of this kind instead. entries that
+    // were just written or loaded by a concurrent run are among the newest and survive
+    namespace fs = std::filesystem;
+    std::error_code ec;
+    auto prefix = kind_ + "-";
+    auto now = fs::file_time_type::clock::now();
+    std::vector<std::pair<fs::file_time_type, fs::path>> entries;
+    for (auto const &entry : fs::directory_iterator(directory_, ec)) {
+        auto name = entry.path().filename().string();
+        if (name.rfind(prefix, 0) != 0) continue;
+        auto time = entry.last_write_time(ec);
+        if (ec) continue;
+        auto extension = entry.path().extension();
+        if (extension == ".bin") {
+            entries.emplace_back(time, entry.path());
+        } else if (extension == ".tmp" && now - time > STALE_TEMP_AGE) {
+            fs::remove(entry.path(), ec);
+        }
+    }
+    if (entries.size() <= MAX_CACHE_ENTRIES) return;
+
+    std::sort(entries.begin(), entries.end(),
+              [](auto const &a, auto const &b) { return a.first > b.first; });
+    for (auto i = MAX_CACHE_ENTRIES; i < entries.size(); i++) {
+        fs::remove(entries[i].second, ec);
+    }
+}
+
+std::string InputCache::entry_path(const std::string &key) const {
+    auto path = std::filesystem::path(directory_) / (kind_ + "-" + key + ".bin");
+    return path.string();
+}
@@ -0,0 +1,66 @@
+#ifndef HGDB_VITIS_CACHE_HH
+#define HGDB_VITIS_CACHE_HH
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// on-disk cache for parsed inputs, e.g. debug bitcode summaries and RTL info.
+// entries are keyed by the content of every input file plus the tool version, so any change
+// to the inputs or to the tool simply misses the cache. only the most recently used entries of
+// each kind are kept in the cache directory
+
+// bump this whenever the layout of any cached payload changes
+constexpr uint32_t CACHE_FORMAT_VERSION = 3;
+
+class BinaryWriter {
+public:
+    void write(uint32_t value);
+    void write(std::string_view value);
+
+    [[nodiscard]] inline const std::string &data() const { return buffer_; }
+
+private:
+    std::string buffer_;
+};
+
+class BinaryReader {
+public:
+    explicit BinaryReader(std::string_view data) : data_(data) {}
+
+    // both return false once the data runs out. callers should treat that as a cache miss
+    bool read(uint32_t &value);
+    bool read(std::string &value);
+
+    [[nodiscard]] inline bool done() const { return pos_ == data_.size(); }
+
+private:
+    std::string_view data_;
+    uint64_t pos_ = 0;
+};
+
+class InputCache {
+public:
+    // empty directory disables the cache
+    InputCache(std::string directory, std::string kind);
+
+    [[nodiscard]] inline bool enabled() const { return !directory_.empty(); }
+
+    // salt is used for any option that changes the parsing result
+    [[nodiscard]] std::string compute_key(const std::vector<std::string> &files,
+                                          const std::string &salt) const;
+
+    [[nodiscard]] std::optional<std::string> load(const std::string &key) const;
+    void store(const std::string &key, const std::string &payload) const;
+
+private:
+    std::string directory_;
+    std::string kind_;
+
+    [[nodiscard]] std::string entry_path(const std::string &key) const;
+    void evict() const;
+};
+
+#endif  // HGDB_VITIS_CACHE_HH
@@ -8,25 +8,46 @@
 #include "llvm/Support/SourceMgr.h"
 #include "llvm/Transforms/Utils/Local.h"
 #include "llvm/IR/IntrinsicInst.h"
+#include "cache.hh"
+#include "future.hh"
+#include "parallel.hh"
 #include "pybind11/pybind11.h"
 #include "pybind11/stl.h"
 
-llvm::LLVMContext *get_llvm_context() {
-    static std::unique_ptr<llvm::LLVMContext> context;
-    if (!context) {
-        context = std::make_unique<llvm::LLVMContext>();
-    }
-    return context.get();
-}
+namespace py = pybind11;
+
+// filename -> function name -> line range
+using FunctionScopes =
+    std::map<std::string, std::map<std::string, std::pair<uint32_t, uint32_t>>>;
+// function name -> [(arg name, line, array dims)]
+using FunctionArgs =
+    std::map<std::string, std::vector<std::tuple<std::string, uint32_t, std::vector<uint32_t>>>>;
 
-std::string resolve_filename(const std::string &filename, const std::string &directory) {
+struct DebugIndex {
+    FunctionScopes scopes;
+    FunctionArgs args;
+};
+
+std::string resolve_filename(const std::string &filename) {
     namespace fs = std::filesystem;
-    fs::path path = directory;
-    path /= filename;
-    auto res = fs::weakly_canonical(fs::absolute(path));
+    auto res = fs::weakly_canonical(fs::absolute(filename));
     return res.string();
 }
 
+// resolution depends on symlinks, existing paths and the working directory, none of which is
+// part of the cache key. so the index keeps the names as they appear in the debug info and they
+// are resolved every time the index is handed out
+FunctionScopes resolve_filenames(const FunctionScopes &scopes) {
+    FunctionScopes res;
+    for (auto const &[filename, functions] : scopes) {
+        auto &target = res[resolve_filename(filename)];
+        for (auto const &[func_name, range] : functions) {
+            target[func_name] = range;
+        }
+    }
+    return res;
+}
+
 std::unordered_map<const llvm::Value *, const llvm::CallInst *> index_debug_declare(
     const llvm::Function *function) {
     std::unordered_map<const llvm::Value *, const llvm::CallInst *> res;
@@ -50,100 +71,236 @@ std::unordered_map<const llvm::Value *, const llvm::CallInst *> index_debug_decl
 // because the optimized build has all the function scopes messed up, we need to extract out
 // proper scopes from the debug build then use the source location to reconstruct the scopes
 
-PYBIND11_MODULE(vitis0, m) {
-    m.def("get_function_scopes", [](const std::vector<std::string> &filenames) {
-        // for now, we only use the following format
-        // filename -> function name -> line range
-        std::map<std::string, std::map<std::string, std::pair<uint32_t, uint32_t>>> res;
-        llvm::SMDiagnostic error;
-        for (auto const &filename : filenames) {
-            auto module = llvm::parseIRFile(filename, error, *get_llvm_context());
-            if (!module) continue;
-            for (auto const &func : *module) {
-                // need to resolve the filename
-                std::string resolved_filename;
-                uint32_t min = std::numeric_limits<uint32_t>::max();
-                uint32_t max = 0;
-                for (auto const &blk : func) {
-                    for (auto const &instr : blk) {
-                        auto const &loc = instr.getDebugLoc();
-                        auto *di_loc = loc.get();
-                        if (!di_loc) continue;
-                        auto line = loc.getLine();
-                        if (line == 0) continue;
-                        if (max < line) max = line;
-                        if (min > line) min = line;
-
-                        if (resolved_filename.empty()) {
-                            // get filename
-                            auto fn = di_loc->getFilename().str();
-                            auto dir = di_loc->getDirectory().str();
-                            resolved_filename = resolve_filename(fn, dir);
-                        }
-                    }
-                }
-                auto function_name = func.getName().str();
-                if (!resolved_filename.empty()) {
-                    res[resolved_filename][function_name] = std::make_pair(min, max);
+void index_function_scope(const llvm::Function &func, FunctionScopes &res) {
+    // directory + filename from the debug info, resolved later by resolve_filenames
+    std::string filename;
+    uint32_t min = std::numeric_limits<uint32_t>::max();
+    uint32_t max = 0;
+    for (auto const &blk : func) {
+        for (auto const &instr : blk) {
+            auto const &loc = instr.getDebugLoc();
+            auto *di_loc = loc.get();
+            if (!di_loc) continue;
+            auto line = loc.getLine();
+            if (line == 0) continue;
+            if (max < line) max = line;
+            if (min > line) min = line;
+
+            if (filename.empty()) {
+                auto path = std::filesystem::path(di_loc->getDirectory().str());
+                path /= di_loc->getFilename().str();
+                filename = path.string();
+            }
+        }
+    }
+    auto function_name = func.getName().str();
+    if (!filename.empty()) {
+        res[filename][function_name] = std::make_pair(min, max);
+    }
+}
+
+void index_function_args(const llvm::Function &func, FunctionArgs &res) {
+    auto func_name = func.getName().str();
+    for (auto const &arg : func.args()) {
+        llvm::SmallVector<llvm::DbgVariableIntrinsic *, 1> debug_values;
+        for (auto use : arg.users()) {
+            if (auto store = llvm::dyn_cast<llvm::StoreInst>(use)) {
+                // find debug call
+                auto *store_dst = store->getPointerOperand();
+                if (!store_dst) continue;
+                llvm::findDbgUsers(debug_values, const_cast<llvm::Value *>(store_dst));
+            }
+        }
+        if (debug_values.empty()) continue;
+        auto local_var = debug_values[0]->getVariable();
+        if (!local_var) continue;
+        auto name = local_var->getName().str();
+        auto line = local_var->getLine();
+        auto *t = local_var->getType();
+        if (!t) continue;
+        std::vector<uint32_t> entry;
+        if (llvm::isa<llvm::DIBasicType>(t)) {
+            // for basic type we directly store them
+            res[func_name].emplace_back(std::make_tuple(name, line, entry));
+        } else if (auto derived_type = llvm::dyn_cast<llvm::DIDerivedType>(t)) {
+            auto base_type = derived_type->getBaseType();
+            if (auto composite = llvm::dyn_cast<llvm::DICompositeType>(base_type)) {
+                // we only deal with multi-dim array for now
+                auto elements = composite->getElements();
+                for (auto const &a : elements) {
+                    auto sub = llvm::dyn_cast<llvm::DISubrange>(a);
+                    if (!sub) continue;
+                    auto count = sub->getCount().get<llvm::ConstantInt *>();
+                    if (!count) continue;
+                    entry.emplace_back(count->getLimitedValue());
                 }
+                // do we need to worry about the lower dim?
+                // or we assume vitis is going to use reg file/SRAM instead?
+                res[func_name].emplace_back(std::make_tuple(name, line, entry));
             }
         }
+    }
+}
 
-        return res;
-    });
+std::string serialize_debug_index(const DebugIndex &index) {
+    BinaryWriter writer;
+    writer.write(static_cast<uint32_t>(index.scopes.size()));
+    for (auto const &[filename, functions] : index.scopes) {
+        writer.write(filename);
+        writer.write(static_cast<uint32_t>(functions.size()));
+        for (auto const &[func_name, range] : functions) {
+            writer.write(func_name);
+            writer.write(range.first);
+            writer.write(range.second);
+        }
+    }
+    writer.write(static_cast<uint32_t>(index.args.size()));
+    for (auto const &[func_name, vars] : index.args) {
+        writer.write(func_name);
+        writer.write(static_cast<uint32_t>(vars.size()));
+        for (auto const &[name, line, dims] : vars) {
+            writer.write(name);
+            writer.write(line);
+            writer.write(static_cast<uint32_t>(dims.size()));
+            for (auto dim : dims) writer.write(dim);
+        }
+    }
+    return writer.data();
+}
 
-    m.def("get_function_args", [](const std::vector<std::string> &filenames) {
-        llvm::SMDiagnostic error;
-        std::map<std::string, std::vector<std::tuple<std::string, uint32_t, std::vector<uint32_t>>>>
-            res;
-        for (auto const &filename : filenames) {
-            auto module = llvm::parseIRFile(filename, error, *get_llvm_context());
-            if (!module) continue;
-
-            for (auto const &func : *module) {
-                auto func_name = func.getName().str();
-                for (auto const &arg : func.args()) {
-                    llvm::SmallVector<llvm::DbgVariableIntrinsic *, 1> debug_values;
-                    for (auto use : arg.users()) {
-                        if (auto store = llvm::dyn_cast<llvm::StoreInst>(use)) {
-                            // find debug call
-                            auto *store_dst = store->getPointerOperand();
-                            if (!store_dst) continue;
-                            llvm::findDbgUsers(debug_values, const_cast<llvm::Value *>(store_dst));
-                        }
-                    }
-                    if (debug_values.empty()) continue;
-                    auto local_var = debug_values[0]->getVariable();
-                    if (!local_var) continue;
-                    auto name = local_var->getName().str();
-                    auto line = local_var->getLine();
-                    auto *t = local_var->getType();
-                    if (!t) continue;
-                    std::vector<uint32_t> entry;
-                    if (llvm::isa<llvm::DIBasicType>(t)) {
-                        // for basic type we directly store them
-                        res[func_name].emplace_back(std::make_tuple(name, line, entry));
-                    } else if (auto derived_type = llvm::dyn_cast<llvm::DIDerivedType>(t)) {
-                        auto base_type = derived_type->getBaseType();
-                        if (auto composite = llvm::dyn_cast<llvm::DICompositeType>(base_type)) {
-                            // we only deal with multi-dim array for now
-                            auto elements = composite->getElements();
-                            for (auto const &a : elements) {
-                                auto sub = llvm::dyn_cast<llvm::DISubrange>(a);
-                                if (!sub) continue;
-                                auto count = sub->getCount().get<llvm::ConstantInt *>();
-                                if (!count) continue;
-                                entry.emplace_back(count->getLimitedValue());
-                            }
-                            // do we need to worry about the lower dim?
-                            // or we assume vitis is going to use reg file/SRAM instead?
-                            res[func_name].emplace_back(std::make_tuple(name, line, entry));
-                        }
-                    }
-                }
+std::optional<DebugIndex> deserialize_debug_index(const std::string &data) {
+    BinaryReader reader(data);
+    DebugIndex index;
+    uint32_t num_files;
+    if (!reader.read(num_files)) return std::nullopt;
+    for (auto i = 0u; i < num_files; i++) {
+        std::string filename;
+        uint32_t num_functions;
+        if (!reader.read(filename) || !reader.read(num_functions)) return std::nullopt;
+        auto &functions = index.scopes[filename];
+        for (auto j = 0u; j < num_functions; j++) {
+            std::string func_name;
+            uint32_t min, max;
+            if (!reader.read(func_name) || !reader.read(min) || !reader.read(max)) {
+                return std::nullopt;
             }
+            functions.emplace(func_name, std::make_pair(min, max));
         }
+    }
+    uint32_t num_functions;
+    if (!reader.read(num_functions)) return std::nullopt;
+    for (auto i = 0u; i < num_functions; i++) {
+        std::string func_name;
+        uint32_t num_vars;
+        if (!reader.read(func_name) || !reader.read(num_vars)) return std::nullopt;
+        auto &vars = index.args[func_name];
+        for (auto j = 0u; j < num_vars; j++) {
+            std::string name;
+            uint32_t line, num_dims;
+            if (!reader.read(name) || !reader.read(line) || !reader.read(num_dims)) {
+                return std::nullopt;
+            }
+            std::vector<uint32_t> dims(num_dims);
+            for (auto &dim : dims) {
+                if (!reader.read(dim)) return std::nullopt;
+            }
+            vars.emplace_back(std::make_tuple(name, line, dims));
+        }
+    }
+    if (!reader.done()) return std::nullopt;
+    return index;
+}
 
-        return res;
+DebugIndex index_debug_bitcode(const std::vector<std::string> &filenames, uint32_t num_threads) {
+    // each file is parsed exactly once and both scopes and args are extracted in the same walk.
+    // results are kept per file so that the merge below is independent of the scheduling
+    std::vector<DebugIndex> file_indices(filenames.size());
+    // LLVMContext is not thread-safe, so every worker owns one
+    std::vector<llvm::LLVMContext> contexts(resolve_num_threads(num_threads, filenames.size()));
+    parallel_for(filenames.size(), num_threads, [&](uint64_t idx, uint32_t thread_id) {
+        llvm::SMDiagnostic error;
+        auto module = llvm::parseIRFile(filenames[idx], error, contexts[thread_id]);
+        if (!module) return;
+        auto &index = file_indices[idx];
+        for (auto const &func : *module) {
+            index_function_scope(func, index.scopes);
+            index_function_args(func, index.args);
+        }
     });
-}
\ No newline at end of file
+
+    // merge in the input file order, which gives the same result as a sequential run
+    DebugIndex res;
+    for (auto &index : file_indices) {
+        for (auto &[filename, functions] : index.scopes) {
+            auto &target = res.scopes[filename];
+            for (auto &[func_name, range] : functions) {
+                target[func_name] = range;
+            }
+        }
+        for (auto &[func_name, vars] : index.args) {
+            auto &target = res.args[func_name];
+            target.insert(target.end(), std::make_move_iterator(vars.begin()),
+                          std::make_move_iterator(vars.end()));
+        }
+    }
+
+    return res;
+}
+
+DebugIndex index_debug_bitcode(const std::vector<std::string> &filenames, uint32_t num_threads,
+                               const std::string &cache_dir) {
+    InputCache cache(cache_dir, "debug-bc");
+    std::string key;
+    if (cache.enabled()) {
+        key = cache.compute_key(filenames, {});
+        if (auto data = cache.load(key)) {
+            if (auto index = deserialize_debug_index(*data)) {
+                index->scopes = resolve_filenames(index->scopes);
+                return std::move(*index);
+            }
+        }
+    }
+
+    auto index = index_debug_bitcode(filenames, num_threads);
+    if (cache.enabled()) {
+        cache.store(key, serialize_debug_index(index));
+    }
+    index.scopes = resolve_filenames(index.scopes);
+    return index;
+}
+
+// (scopes, args), which converts into a Python tuple
+std::pair<FunctionScopes, FunctionArgs> index_debug_bitcode_pair(
+    const std::vector<std::string> &filenames, uint32_t num_threads, const std::string &cache_dir) {
+    auto index = index_debug_bitcode(filenames, num_threads, cache_dir);
+    return std::make_pair(std::move(index.scopes), std::move(index.args));
+}
+
+PYBIND11_MODULE(vitis0, m) {
+    bind_future<std::pair<FunctionScopes, FunctionArgs>>(m, "DebugIndexFuture");
+
+    m.def("index_debug_bitcode", &index_debug_bitcode_pair, py::arg("filenames"),
+          py::arg("num_threads") = 0, py::arg("cache_dir") = "",
+          py::call_guard<py::gil_scoped_release>());
+    m.def(
+        "index_debug_bitcode_async",
+        [](const std::vector<std::string> &filenames, uint32_t num_threads,
+           const std::string &cache_dir) {
+            return launch_async(&index_debug_bitcode_pair, filenames, num_threads, cache_dir);
+        },
+        py::arg("filenames"), py::arg("num_threads") = 0, py::arg("cache_dir") = "");
+
+    m.def(
+        "get_function_scopes",
+        [](const std::vector<std::string> &filenames) {
+            return index_debug_bitcode(filenames, 1).scopes;
+        },
+        py::call_guard<py::gil_scoped_release>());
+
+    m.def(
+        "get_function_args",
+        [](const std::vector<std::string> &filenames) {
+            return index_debug_bitcode(filenames, 1).args;
+        },
+        py::call_guard<py::gil_scoped_release>());
+}
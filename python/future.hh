@@ -0,0 +1,52 @@
+#ifndef HGDB_VITIS_FUTURE_HH
+#define HGDB_VITIS_FUTURE_HH
+
+#include <chrono>
+#include <future>
+#include <type_traits>
+#include <utility>
+
+#include "pybind11/pybind11.h"
+
+// result of a native call running on its own thread. the call never touches Python objects, so
+// it keeps going while the interpreter does other work. waiting releases the GIL
+template <typename T>
+class Future {
+public:
+    explicit Future(std::future<T> future) : future_(future.share()) {}
+
+    [[nodiscard]] bool done() const {
+        return future_.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+    }
+
+    // rethrows whatever the native call threw
+    const T &result() const {
+        {
+            pybind11::gil_scoped_release release;
+            future_.wait();
+        }
+        return future_.get();
+    }
+
+private:
+    std::shared_future<T> future_;
+};
+
+// starts f(args...) on a new thread. arguments are copied, so they must not refer to Python
+// objects
+template <typename F, typename... Args>
+auto launch_async(F &&f, Args &&...args) {
+    using T = std::invoke_result_t<std::decay_t<F>, std::decay_t<Args>...>;
+    return Future<T>(
+        std::async(std::launch::async, std::forward<F>(f), std::forward<Args>(args)...));
+}
+
+// every extension module binds its own futures, since they are built against different C++ ABIs
+template <typename T>
+void bind_future(pybind11::module &m, const char *name) {
+    pybind11::class_<Future<T>>(m, name, pybind11::module_local())
+        .def("done", &Future<T>::done)
+        .def("result", &Future<T>::result, pybind11::return_value_policy::automatic_reference);
+}
+
+#endif  // HGDB_VITIS_FUTURE_HH
@@ -2,35 +2,44 @@
 
 #include <cxxabi.h>
 
+#include <algorithm>
 #include <filesystem>
 #include <iostream>
 #include <optional>
-#include <queue>
-#include <stack>
+#include <tuple>
 #include <unordered_set>
 
+#include "llvm/ADT/OwningPtr.h"
 #include "llvm/ADT/StringMap.h"
 #include "llvm/Analysis/DebugInfo.h"
+#include "llvm/Bitcode/ReaderWriter.h"
 #include "llvm/Constants.h"
 #include "llvm/Instructions.h"
 #include "llvm/LLVMContext.h"
 #include "llvm/Support/DebugLoc.h"
 #include "llvm/Support/IRReader.h"
+#include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/SourceMgr.h"
 #include "llvm/Support/raw_ostream.h"
-
-llvm::LLVMContext *get_llvm_context() {
-    static std::unique_ptr<llvm::LLVMContext> context;
-    if (!context) {
-        context = std::make_unique<llvm::LLVMContext>();
+#include "parallel.hh"
+#include "rtl_table.hh"
+
+bool materialize(const llvm::Function *function) {
+    if (!function || !function->isMaterializable()) return true;
+    std::string error;
+    // materializing only reads in the function body from the bitcode
+    if (const_cast<llvm::Function *>(function)->Materialize(&error)) {
+        std::cerr << "Unable to materialize " << function->getName().str() << ": " << error
+                  << std::endl;
+        return false;
     }
-    return context.get();
+    return true;
 }
 
 std::vector<const llvm::Instruction *> get_function_instructions(const llvm::Module &module,
                                                                  const std::string &func_name) {
     auto *function = module.getFunction(func_name);
-    if (!function) return {};
+    if (!function || !materialize(function)) return {};
     std::vector<const llvm::Instruction *> res;
     res.reserve(function->size());
     for (auto const &blk : *function) {
@@ -43,7 +52,7 @@ std::vector<const llvm::Instruction *> get_function_instructions(const llvm::Mod
 
 std::string get_filename(const llvm::Instruction *inst) {
     auto const &loc = inst->getDebugLoc();
-    auto *scope = loc.getAsMDNode(*get_llvm_context());
+    auto *scope = loc.getAsMDNode(inst->getContext());
     if (scope) {
         auto di_location = llvm::DILocation(scope);
         return di_location.getFilename().str();
@@ -70,7 +79,7 @@ const llvm::Function *get_function(const llvm::Instruction *inst) {
 std::map<std::string, std::map<uint32_t, std::vector<const llvm::Instruction *>>> get_instr_loc(
     const llvm::Function *function) {
     std::map<std::string, std::map<uint32_t, std::vector<const llvm::Instruction *>>> result;
-    if (!function) return {};
+    if (!function || !materialize(function)) return {};
 
     for (auto const &blk : *function) {
         for (auto const &inst : blk) {
@@ -86,7 +95,8 @@ std::map<std::string, std::map<uint32_t, std::vector<const llvm::Instruction *>>
 
 // NOLINTNEXTLINE
 void get_contained_functions(const llvm::Function *function, std::set<std::string> &res) {
-    if (!function) return;
+    // only the functions reachable from the call graph get materialized
+    if (!function || !materialize(function)) return;
     for (auto const &blk : *function) {
         for (auto const &inst : blk) {
             if (llvm::isa<llvm::CallInst>(inst)) {
@@ -111,25 +121,41 @@ std::set<std::string> get_contained_functions(const llvm::Function *function) {
 }
 
 std::map<std::string, const llvm::Function *> get_optimized_functions(
-    const llvm::Module *module, const std::set<std::string> &function_names) {
+    const llvm::Module *module, const std::set<std::string> &function_names,
+    uint32_t num_threads) {
     // use the fact that all transformed basic blocks as original function name's label with .exit
-    std::map<std::string, const llvm::Function *> res;
-    std::unordered_map<std::string, std::string> processed_names;
-    for (auto const &func : function_names) {
-        processed_names.emplace(func, func + ".exit");
-    }
-    auto const &functions = module->getFunctionList();
-    for (auto const &function : functions) {
-        for (auto const &block : function) {
-            auto name = block.getName().str();
-            for (auto const &[func_name, label] : processed_names) {
-                if (name.rfind(label, 0) == 0) {
-                    // found it
-                    res.emplace(func_name, &function);
-                    break;
-                }
+    // every body has to be scanned, so this loads the whole module even when it was parsed lazily.
+    // lazy loading is not thread-safe, so bodies are read in before the threads start
+    std::vector<const llvm::Function *> functions;
+    for (auto const &function : module->getFunctionList()) {
+        if (materialize(&function)) functions.emplace_back(&function);
+    }
+
+    // a block named <name>.exit... matches the name if the stem in front of any ".exit" is one
+    // of the requested functions, which is a single hash lookup per occurrence
+    constexpr std::string_view exit_label = ".exit";
+    std::unordered_set<std::string_view> names(function_names.begin(), function_names.end());
+    // function index -> matched names
+    std::vector<std::vector<std::string_view>> matches(functions.size());
+    parallel_for(functions.size(), num_threads, [&](uint64_t idx) {
+        auto &found = matches[idx];
+        for (auto const &block : *functions[idx]) {
+            auto block_name = block.getName();
+            std::string_view name(block_name.data(), block_name.size());
+            for (auto pos = name.find(exit_label); pos != std::string_view::npos;
+                 pos = name.find(exit_label, pos + 1)) {
+                auto it = names.find(name.substr(0, pos));
+                if (it != names.end()) found.emplace_back(*it);
             }
         }
+    });
+
+    // the first function in module order wins, same as a sequential scan
+    std::map<std::string, const llvm::Function *> res;
+    for (auto i = 0u; i < functions.size(); i++) {
+        for (auto const &name : matches[i]) {
+            res.emplace(std::string(name), functions[i]);
+        }
     }
 
     return res;
@@ -187,12 +213,40 @@ std::string guess_rtl_name(const llvm::Instruction *instruction) {
     return {};
 }
 
-llvm::Module *parse_llvm_bitcode(const std::string &path) {
+llvm::Module *parse_llvm_bitcode(const std::string &path, bool lazy) {
+    // owned by the module from here on, see release_llvm_bitcode
+    auto llvm_context = std::make_unique<llvm::LLVMContext>();
+    if (lazy) {
+        llvm::OwningPtr<llvm::MemoryBuffer> buffer;
+        if (auto ec = llvm::MemoryBuffer::getFile(path, buffer)) {
+            std::cerr << "Unable to read " << path << ": " << ec.message() << std::endl;
+            return nullptr;
+        }
+        auto const *start = reinterpret_cast<const unsigned char *>(buffer->getBufferStart());
+        auto const *end = reinterpret_cast<const unsigned char *>(buffer->getBufferEnd());
+        // textual IR can't be materialized lazily. fall back to the normal parser
+        if (llvm::isBitcode(start, end)) {
+            std::string error;
+            // function bodies are only read when materialize() is called on them
+            auto *module = llvm::getLazyBitcodeModule(buffer.get(), *llvm_context, &error);
+            if (!module) {
+                std::cerr << error << std::endl;
+                return nullptr;
+            }
+            // the module owns the buffer now
+            buffer.take();
+            llvm_context.release();
+            return module;
+        }
+    }
+
     llvm::SMDiagnostic error;
-    auto module = llvm::ParseIRFile(path, error, *get_llvm_context());
+    auto module = llvm::ParseIRFile(path, error, *llvm_context);
     if (!module) {
         std::cerr << error.getMessage() << std::endl;
+        return nullptr;
     }
+    llvm_context.release();
     return module;
 }
 
@@ -204,6 +258,99 @@ std::string resolve_filename(const std::string &filename, const std::string &dir
     return res.string();
 }
 
+uint32_t FilenameResolver::resolve(const std::string &filename, const std::string &directory) {
+    // directory can't contain null characters, so this is unique for every pair
+    auto key = directory;
+    key.append(1, '\0').append(filename);
+    {
+        std::lock_guard guard(mutex_);
+        num_lookups_++;
+        auto it = entries_.find(key);
+        if (it != entries_.end()) {
+            saved_syscalls_ += it->second.cost;
+            return it->second.id;
+        }
+    }
+
+    // touch the file system without holding the lock. if another thread resolves the same pair
+    // in the meantime, the first one to finish wins
+    auto resolved = resolve_filename(filename, directory);
+    // weakly_canonical stats or reads links for every path component
+    std::filesystem::path resolved_path = resolved;
+    auto cost = static_cast<uint32_t>(std::distance(resolved_path.begin(), resolved_path.end()));
+
+    std::lock_guard guard(mutex_);
+    auto it = entries_.find(key);
+    if (it != entries_.end()) return it->second.id;
+    uint32_t id;
+    auto canonical_it = canonical_ids_.find(resolved);
+    if (canonical_it != canonical_ids_.end()) {
+        // different pairs can point to the same file
+        id = canonical_it->second;
+    } else {
+        id = static_cast<uint32_t>(filenames_.size());
+        canonical_ids_.emplace(resolved, id);
+        filenames_.emplace_back(std::move(resolved));
+    }
+    entries_.emplace(std::move(key), Entry{id, cost});
+    return id;
+}
+
+const std::string &FilenameResolver::filename(uint32_t id) const {
+    std::lock_guard guard(mutex_);
+    return filenames_[id];
+}
+
+uint64_t FilenameResolver::num_lookups() const {
+    std::lock_guard guard(mutex_);
+    return num_lookups_;
+}
+
+uint64_t FilenameResolver::num_files() const {
+    std::lock_guard guard(mutex_);
+    return filenames_.size();
+}
+
+uint64_t FilenameResolver::saved_syscalls() const {
+    std::lock_guard guard(mutex_);
+    return saved_syscalls_;
+}
+
+StringPool::StringPool() {
+    strings_.emplace_back();
+    symbols_.emplace(strings_.back(), EMPTY_SYMBOL);
+}
+
+Symbol StringPool::intern(std::string_view value) {
+    if (auto symbol = find(value)) return *symbol;
+    std::unique_lock lock(mutex_);
+    // someone else may have added it in between
+    auto it = symbols_.find(value);
+    if (it != symbols_.end()) return it->second;
+    auto symbol = static_cast<Symbol>(strings_.size());
+    // deque never moves its elements, so the key stays valid
+    auto const &str = strings_.emplace_back(value);
+    symbols_.emplace(str, symbol);
+    return symbol;
+}
+
+std::optional<Symbol> StringPool::find(std::string_view value) const {
+    std::shared_lock lock(mutex_);
+    auto it = symbols_.find(value);
+    if (it == symbols_.end()) return std::nullopt;
+    return it->second;
+}
+
+std::string_view StringPool::str(Symbol symbol) const {
+    std::shared_lock lock(mutex_);
+    return strings_[symbol];
+}
+
+uint64_t StringPool::size() const {
+    std::shared_lock lock(mutex_);
+    return strings_.size();
+}
+
 // NOLINTNEXTLINE
 void find_array_range(const llvm::MDNode *node, std::vector<uint32_t> &res) {
     if (!node) return;
@@ -271,24 +418,10 @@ std::vector<Scope *> process_var_decl(const llvm::CallInst &call_inst, Context &
                                                 : root_scope->module->rtl_module_name();
 
         if (instance_name.empty()) {
-            if (rtl_info.signals.find(module_name) == rtl_info.signals.end()) {
-                return false;
-            }
-            auto const &signals = rtl_info.signals.at(module_name);
-            if (signals.find(rtl_name) == signals.end()) {
-                return false;
-            }
+            if (!rtl_info.has_signal(module_name, rtl_name)) return false;
         } else {
-            auto const &instances = rtl_info.instances.at(module_name);
-            if (instances.find(instance_name) == instances.end()) {
-                return false;
-            }
-            auto const &target_module_name = instances.at(instance_name);
-            if (rtl_info.signals.find(target_module_name) == rtl_info.signals.end()) {
-                return false;
-            }
-            auto const &signals = rtl_info.signals.at(target_module_name);
-            if (signals.find(rtl_name) == signals.end()) {
+            auto target_module_name = rtl_info.find_instance_definition(module_name, instance_name);
+            if (!target_module_name || !rtl_info.has_signal(*target_module_name, rtl_name)) {
                 return false;
             }
             rtl_name = instance_name + "." + rtl_name;
@@ -390,16 +523,13 @@ std::vector<Scope *> process_var_decl(const llvm::CallInst &call_inst, Context &
     uint32_t line = line_num == 0 ? debug_loc.getLine() : line_num;
 
     // need to guess the name since there is usually no direct correspondence
-    auto const &signals = rtl_info.signals.at(root_scope->module->rtl_module_name());
     // fuzzy search to get reg value
     auto search_name = ref_var->getName().str() + "_reg";
-    for (auto const &[rtl_name, width] : signals) {
-        if (rtl_name.rfind(search_name, 0) == 0) {
-            // found it
-            Variable v(var_name, rtl_name);
-            auto *s = context.add_scope<DeclInstruction>(root_scope, v, line);
-            return {s};
-        }
+    if (auto rtl_name = rtl_info.find_signal_with_prefix(root_scope->module->rtl_module_name(),
+                                                         search_name)) {
+        Variable v(var_name, std::string(*rtl_name));
+        auto *s = context.add_scope<DeclInstruction>(root_scope, v, line);
+        return {s};
     }
 
     // trying to figure out if we can use the caller information
@@ -418,7 +548,8 @@ std::vector<Scope *> process_var_decl(const llvm::CallInst &call_inst, Context &
                 idx++;
             }
             if (found) {
-                // trying to figure out the use calls
+                // trying to figure out the use calls. with lazy loading, use_begin() only sees
+                // the callers whose bodies have been materialized
                 std::string mem_arg_name;
                 for (auto use = func->use_begin(); use != func->use_end(); use++) {
                     if (auto *call = llvm::dyn_cast<llvm::CallInst>(*use)) {
@@ -429,32 +560,17 @@ std::vector<Scope *> process_var_decl(const llvm::CallInst &call_inst, Context &
                 }
                 if (!mem_arg_name.empty()) {
                     // figure out if this signal exists
-                    // brute force to resolve the instances
+                    // the memory is instantiated next to this module, i.e. in one of its parents
                     auto rtl_module_name = root_scope->module->rtl_module_name();
                     auto mem_inst_name = mem_arg_name + "_U";
-                    for (auto const &[m, children] : rtl_info.instances) {
-                        bool same_level = false;
-                        std::string mem_def_name;
-                        for (auto const &[inst, def] : children) {
-                            if (def == rtl_module_name) {
-                                same_level = true;
-                            }
-                            if (inst == mem_inst_name) {
-                                mem_def_name = def;
-                            }
-                        }
-
-                        if (same_level && !mem_def_name.empty()) {
-                            if (rtl_info.signals.find(mem_def_name) != rtl_info.signals.end()) {
-                                auto const &ss = rtl_info.signals.at(mem_def_name);
-                                if (ss.find("ram") != ss.end()) {
-                                    auto rtl_name = "$parent." + mem_inst_name + ".ram";
-                                    Variable v(var_name, rtl_name);
-                                    auto *s =
-                                        context.add_scope<DeclInstruction>(root_scope, v, line);
-                                    return {s};
-                                }
-                            }
+                    for (auto const &parent : rtl_info.parent_modules(rtl_module_name)) {
+                        auto mem_def_name =
+                            rtl_info.find_instance_definition(parent, mem_inst_name);
+                        if (mem_def_name && rtl_info.has_signal(*mem_def_name, "ram")) {
+                            auto rtl_name = "$parent." + mem_inst_name + ".ram";
+                            Variable v(var_name, rtl_name);
+                            auto *s = context.add_scope<DeclInstruction>(root_scope, v, line);
+                            return {s};
                         }
                     }
                 }
@@ -466,13 +582,19 @@ std::vector<Scope *> process_var_decl(const llvm::CallInst &call_inst, Context &
 }
 
 Scope *get_debug_scope(const llvm::Function *function, Context &context, ModuleInfo *module) {
-    if (!function) return nullptr;
+    if (!function || !materialize(function)) return nullptr;
     auto *root_scope = context.add_scope<Scope>(nullptr);
     root_scope->module = module;
     std::unordered_map<const llvm::DIScope *, Scope *> scope_mapping;
 
     std::unordered_set<uint32_t> lines;
     std::unordered_set<std::string> handled_vars;
+    auto &resolver = context.filename_resolver();
+    // debug scope -> (resolved filename, raw filename)
+    std::unordered_map<const llvm::MDNode *, std::pair<Symbol, Symbol>> node_filenames;
+    // getAsMDNode may create new metadata in the LLVMContext, which is not thread-safe. looking
+    // up the scope only reads
+    auto const &llvm_context = function->getContext();
 
     for (auto const &blk : *function) {
         for (auto const &instr : blk) {
@@ -480,7 +602,7 @@ Scope *get_debug_scope(const llvm::Function *function, Context &context, ModuleI
             // see the debug information here:
             // https://releases.llvm.org/3.1/docs/SourceLevelDebugging.html
             auto debug_loc = instr.getDebugLoc();
-            auto *node = debug_loc.getAsMDNode(*get_llvm_context());
+            auto *node = debug_loc.getScope(llvm_context);
 
             std::vector<Scope *> res;
             if (llvm::isa<llvm::CallInst>(instr)) {
@@ -497,8 +619,7 @@ Scope *get_debug_scope(const llvm::Function *function, Context &context, ModuleI
                     }
                 }
                 for (auto const *v : res) {
-                    if (v->type() == "decl") {
-                        auto *decl = reinterpret_cast<const DeclInstruction *>(v);
+                    if (auto const *decl = v->as<DeclInstruction>()) {
                         handled_vars.emplace(decl->var.name);
                     }
                 }
@@ -522,17 +643,21 @@ Scope *get_debug_scope(const llvm::Function *function, Context &context, ModuleI
             // invalid
             if (res.empty()) continue;
 
-            for (auto *scope : res) {
-                scope->instruction = &instr;
-
-                // for file name. some declare might not have
-                if (!node) continue;
-                auto loc = llvm::DILocation(node);
-                auto resolved_filename =
-                    resolve_filename(loc.getFilename().str(), loc.getDirectory().str());
-                auto raw_filename = loc.getFilename().str();
+            // for file name. some declare might not have
+            if (!node) continue;
+            auto file_it = node_filenames.find(node);
+            if (file_it == node_filenames.end()) {
+                auto scope = llvm::DIScope(node);
+                auto raw_filename = scope.getFilename().str();
+                auto file_id = resolver.resolve(raw_filename, scope.getDirectory().str());
+                auto filenames = std::make_pair(context.intern(resolver.filename(file_id)),
+                                                context.intern(raw_filename));
+                file_it = node_filenames.emplace(node, filenames).first;
+            }
+            auto [resolved_filename, raw_filename] = file_it->second;
 
-                if (root_scope->filename.empty()) {
+            for (auto *scope : res) {
+                if (root_scope->filename == EMPTY_SYMBOL) {
                     root_scope->filename = resolved_filename;
                     root_scope->raw_filename = raw_filename;
                 }
@@ -548,6 +673,44 @@ Scope *get_debug_scope(const llvm::Function *function, Context &context, ModuleI
     return root_scope;
 }
 
+std::map<std::string, Scope *> build_module_scopes(
+    Context &context, const std::map<std::string, std::shared_ptr<ModuleInfo>> &modules,
+    uint32_t num_threads) {
+    std::vector<ModuleInfo *> targets;
+    targets.reserve(modules.size());
+    for (auto const &[name, module] : modules) {
+        // lazy loading is not thread-safe, so bodies are read in before the threads start
+        if (!module->function || !materialize(module->function)) {
+            throw std::runtime_error("Unable to load function for module " + name);
+        }
+        targets.emplace_back(module.get());
+    }
+
+    // every worker allocates from its own arena, so add_scope needs no locking. a single worker
+    // runs on the calling thread and uses the context's own arena
+    std::vector<ScopeArena *> arenas(resolve_num_threads(num_threads, targets.size()), nullptr);
+    if (arenas.size() > 1) {
+        for (auto &arena : arenas) arena = context.add_arena();
+    }
+
+    std::vector<Scope *> roots(targets.size());
+    parallel_for(targets.size(), num_threads, [&](uint64_t idx, uint32_t thread_id) {
+        context.bind_thread_arena(arenas[thread_id]);
+        auto *module = targets[idx];
+        auto *scope = get_debug_scope(module->function, context, module);
+        scope->bind_state(*module);
+        roots[idx] = scope;
+    });
+    context.bind_thread_arena(nullptr);
+
+    std::map<std::string, Scope *> res;
+    auto root = roots.begin();
+    for (auto const &[name, module] : modules) {
+        res.emplace(name, *root++);
+    }
+    return res;
+}
+
 std::string remap_filename(const std::string &filename, const SerializationOptions &options) {
     // we don't expect this kind of stuff to be done in parallel
     static std::unordered_map<std::string, std::string> mapped_filename;
@@ -581,67 +744,77 @@ std::string remap_filename(const std::string &filename, const SerializationOptio
     return result;
 }
 
-// NOLINTNEXTLINE
 std::string Scope::serialize(const SerializationOptions &options) const {
     std::stringstream ss;
-    ss << "{";
-    ss << R"("type":")" << type() << R"(")";
+    serialize(ss, options);
+    return ss.str();
+}
+
+// NOLINTNEXTLINE
+void Scope::serialize(std::ostream &stream, const SerializationOptions &options) const {
+    stream << "{";
+    stream << R"("type":")" << type() << R"(")";
     if (!scopes.empty()) {
-        ss << R"(,"scope":[)";
+        stream << R"(,"scope":[)";
         for (auto i = 0u; i < scopes.size(); i++) {
-            auto s = scopes[i]->serialize(options);
-            ss << s;
+            scopes[i]->serialize(stream, options);
             if (i != (scopes.size() - 1)) {
-                ss << ",";
+                stream << ",";
             }
         }
-        ss << "]";
+        stream << "]";
     }
 
-    if (!filename.empty()) {
-        auto fn = remap_filename(filename, options);
-        ss << R"(,"filename":")" << fn << '"';
+    if (filename != EMPTY_SYMBOL) {
+        auto fn = remap_filename(std::string(context->str(filename)), options);
+        stream << R"(,"filename":")" << fn << '"';
     }
-    auto member = serialize_member();
-    if (!member.empty()) {
-        ss << "," << member;
+    serialize_member(stream);
+
+    if (!state_ids.empty() || kind() != ScopeKind::Block) {
+        // we flatten out the condition for non-block scopes to avoid complications. this will
+        // increase the symbol table size
+        stream << R"(,"condition":")";
+        write_condition(stream);
+        stream << '"';
     }
+    stream << "}";
+}
+
+std::string Scope::condition() const {
+    std::stringstream ss;
+    write_condition(ss);
+    return ss.str();
+}
 
-    auto idle = instance_prefix + "ap_idle";
+void Scope::write_condition(std::ostream &stream) const {
+    // we hardcode the idle here
+    auto prefix = context->str(instance_prefix);
     if (!state_ids.empty()) {
-        ss << R"(,"condition":"(!)" << idle << ")&&(";
-        // we hardcode the idle here
+        stream << "(!" << prefix << "ap_idle)&&(";
         for (auto i = 0u; i < state_ids.size(); i++) {
-            ss << instance_prefix << state_ids[i];
+            stream << prefix << context->str(state_ids[i]);
             if (i != (state_ids.size() - 1)) {
-                ss << "||";
+                stream << "||";
             }
         }
-        ss << ")\"";
-    } else if (type() != "block") {
-        // we flatten out the condition to avoid complications. this will increase the symbol
-        // table size
-        ss << R"(,"condition":"!)" << idle << '"';
+        stream << ")";
+    } else if (kind() != ScopeKind::Block) {
+        stream << "!" << prefix << "ap_idle";
     }
-    ss << "}";
-    return ss.str();
 }
 
 // NOLINTNEXTLINE
-Scope *Scope::find(const std::function<bool(Scope *)> &predicate) {
-    if (predicate(this)) return this;
-    for (auto *s : scopes) {
-        auto *p = s->find(predicate);
-        if (p) return p;
+void index_scope_location(Scope *scope, Symbol raw_filename,
+                          std::unordered_map<Symbol, LineScopes> &index) {
+    // raw filename is inherited from the parent, so we pass it down instead of walking up
+    // the tree for every scope
+    auto filename = scope->raw_filename == EMPTY_SYMBOL ? raw_filename : scope->raw_filename;
+    if (scope->line > 0) {
+        index[filename][scope->line].emplace_back(scope);
     }
-    return nullptr;
-}
-
-// NOLINTNEXTLINE
-void Scope::find_all(const std::function<bool(Scope *)> &predicate, std::vector<Scope *> &res) {
-    if (predicate(this)) res.emplace_back(this);
-    for (auto *s : scopes) {
-        s->find_all(predicate, res);
+    for (auto *s : scope->scopes) {
+        index_scope_location(s, filename, index);
     }
 }
 
@@ -651,26 +824,29 @@ void Scope::bind_state(ModuleInfo &mod) {
     const std::map<std::string, StateInfo> &state_infos = mod.state_infos;
     // we bind state to scope
     // if the state info has line number, we use that for matching
-    // if not, we brute-force to match the instruction string
-    // I miss C++20 features. structured bindings cannot be captured by lambda expressions until
-    // C++20
-    for (auto const &iter : state_infos) {
-        auto state_id = iter.first;
-        auto const &info = iter.second;
-        std::vector<Scope *> child_scopes;
-        find_all(
-            [&info](Scope *scope) {
-                return std::any_of(
-                    info.instructions.begin(), info.instructions.end(), [scope](auto const &loc) {
-                        return loc.line > 0 && loc.filename == scope->get_raw_filename() &&
-                               loc.line == scope->line;
-                    });
-            },
-            child_scopes);
-        if (!child_scopes.empty()) {
-            // found it
-            for (auto *scope : child_scopes) {
-                scope->state_ids.emplace_back(state_id);
+    // index all the scopes by (raw filename, line) once so that each state location is a
+    // single lookup
+    std::unordered_map<Symbol, LineScopes> index;
+    index_scope_location(this, get_raw_filename(), index);
+
+    auto &strings = context->strings();
+    for (auto const &[state_id, info] : state_infos) {
+        // only interned once the state is bound to a scope
+        auto state_symbol = EMPTY_SYMBOL;
+        for (auto const &loc : info.instructions) {
+            if (loc.line == 0) continue;
+            // files no scope refers to can't be in the pool
+            auto filename = strings.find(loc.filename);
+            if (!filename) continue;
+            auto file_it = index.find(*filename);
+            if (file_it == index.end()) continue;
+            auto line_it = file_it->second.find(loc.line);
+            if (line_it == file_it->second.end()) continue;
+            if (state_symbol == EMPTY_SYMBOL) state_symbol = strings.intern(state_id);
+            for (auto *scope : line_it->second) {
+                // multiple locations in the same state can map to the same scope
+                if (!scope->state_ids.empty() && scope->state_ids.back() == state_symbol) continue;
+                scope->state_ids.emplace_back(state_symbol);
             }
         }
     }
@@ -700,7 +876,7 @@ void Scope::clear_empty() {
 
     auto ss = scopes;
     for (auto *s : ss) {
-        if (s->scopes.empty() && s->type() == "block") {
+        if (s->scopes.empty() && s->kind() == ScopeKind::Block) {
             auto it = std::find(scopes.begin(), scopes.end(), s);
             scopes.erase(it);
         }
@@ -708,41 +884,23 @@ void Scope::clear_empty() {
 }
 
 bool Scope::contains(const Scope *scope) const {
-    if (!module) return false;
-    auto const *mod = scope->module;
-    // breath-first search
-    std::queue<const ModuleInfo *> modules;
-    std::unordered_set<const ModuleInfo *> visited;
-    modules.emplace(module);
-
-    while (!modules.empty()) {
-        auto const *m = modules.front();
-        modules.pop();
-        if (visited.find(m) != visited.end()) {
-            continue;
-        }
-        if (m == mod) return true;
-        visited.emplace(m);
-        for (auto const &[name, inst] : m->instances) {
-            modules.emplace(inst.get());
-        }
-    }
-    return false;
+    if (!module || !scope->module) return false;
+    return context->hierarchy().contains(module, scope->module);
 }
 
 // NOLINTNEXTLINE
-std::string Scope::get_filename() const {
-    if (filename.empty()) {
-        return parent_scope ? parent_scope->get_filename() : "";
+Symbol Scope::get_filename() const {
+    if (filename == EMPTY_SYMBOL) {
+        return parent_scope ? parent_scope->get_filename() : EMPTY_SYMBOL;
     } else {
         return filename;
     }
 }
 
 // NOLINTNEXTLINE
-std::string Scope::get_raw_filename() const {
-    if (raw_filename.empty()) {
-        return parent_scope ? parent_scope->get_raw_filename() : "";
+Symbol Scope::get_raw_filename() const {
+    if (raw_filename == EMPTY_SYMBOL) {
+        return parent_scope ? parent_scope->get_raw_filename() : EMPTY_SYMBOL;
     } else {
         return raw_filename;
     }
@@ -768,7 +926,9 @@ void Scope::set_module(ModuleInfo *mod) {
     }
 }
 
-std::string Instruction::serialize_member() const { return R"("line":)" + std::to_string(line); }
+void Instruction::serialize_member(std::ostream &stream) const {
+    stream << R"(,"line":)" << line;
+}
 
 Scope *Instruction::copy() const {
     auto *new_scope = context->add_scope<Instruction>(nullptr, line);
@@ -776,12 +936,11 @@ Scope *Instruction::copy() const {
     return new_scope;
 }
 
-std::string DeclInstruction::serialize_member() const {
-    auto base = Instruction::serialize_member();
-    base.append(R"(,"variable":{"name":")").append(var.name).append(R"(",)");
-    base.append(R"("value":")").append(var.rtl).append(R"(",)");
-    base.append(R"("rtl":true})");
-    return base;
+void DeclInstruction::serialize_member(std::ostream &stream) const {
+    Instruction::serialize_member(stream);
+    stream << R"(,"variable":{"name":")" << var.name << R"(",)";
+    stream << R"("value":")" << var.rtl << R"(",)";
+    stream << R"("rtl":true})";
 }
 
 Scope *DeclInstruction::copy() const {
@@ -790,6 +949,44 @@ Scope *DeclInstruction::copy() const {
     return new_scope;
 }
 
+ScopeArena::~ScopeArena() { clear(); }
+
+void ScopeArena::clear() {
+    // memory itself is released by the arena
+    for (auto *scope : scopes_) {
+        scope->~Scope();
+    }
+    scopes_.clear();
+}
+
+// arena the current thread allocates scopes from, if bound to a context
+static thread_local std::pair<const Context *, ScopeArena *> thread_arena = {nullptr, nullptr};
+
+Context::~Context() {
+    // every scope is destroyed before any arena releases its memory
+    for (auto &arena : thread_arenas_) {
+        arena->clear();
+    }
+    arena_.clear();
+}
+
+ScopeArena &Context::arena() {
+    if (thread_arena.first == this) return *thread_arena.second;
+    return arena_;
+}
+
+ScopeArena *Context::add_arena() {
+    return thread_arenas_.emplace_back(std::make_unique<ScopeArena>()).get();
+}
+
+void Context::bind_thread_arena(ScopeArena *arena) {
+    if (arena) {
+        thread_arena = {this, arena};
+    } else if (thread_arena.first == this) {
+        thread_arena = {nullptr, nullptr};
+    }
+}
+
 std::shared_ptr<ModuleInfo> Context::get_module(const std::string &name) {
     if (module_infos_.find(name) == module_infos_.end())
         return nullptr;
@@ -800,6 +997,81 @@ std::shared_ptr<ModuleInfo> Context::get_module(const std::string &name) {
 void Context::add_module(const std::string &name, std::shared_ptr<ModuleInfo> mod) {
     mod->context = this;
     module_infos_.emplace(name, std::move(mod));
+    invalidate_hierarchy();
+}
+
+HierarchyIndex &Context::hierarchy() {
+    if (!hierarchy_) hierarchy_ = std::make_unique<HierarchyIndex>(module_infos_);
+    return *hierarchy_;
+}
+
+HierarchyIndex::HierarchyIndex(const std::map<std::string, std::shared_ptr<ModuleInfo>> &modules) {
+    // parent pointers follow the module name order, i.e. the first module that instantiates it
+    for (auto const &[name, module] : modules) {
+        for (auto const &[inst_name, inst] : module->instances) {
+            parents_.emplace(inst.get(), module.get());
+        }
+    }
+    for (auto const &[name, module] : modules) {
+        if (parents_.find(module.get()) == parents_.end()) {
+            add_node(module.get(), "", NONE);
+        }
+    }
+}
+
+// NOLINTNEXTLINE
+uint32_t HierarchyIndex::add_node(const ModuleInfo *module, const std::string &instance_name,
+                                  uint32_t parent) {
+    auto id = static_cast<uint32_t>(nodes_.size());
+    nodes_.emplace_back(Node{module, instance_name, parent, NONE});
+    occurrences_[module].emplace_back(id);
+    for (auto const &[inst_name, inst] : module->instances) {
+        add_node(inst.get(), inst_name, id);
+    }
+    nodes_[id].end = static_cast<uint32_t>(nodes_.size());
+    return id;
+}
+
+uint32_t HierarchyIndex::find_descendant(const ModuleInfo *module,
+                                         const ModuleInfo *target) const {
+    auto mod_it = occurrences_.find(module);
+    auto target_it = occurrences_.find(target);
+    if (mod_it == occurrences_.end() || target_it == occurrences_.end()) return NONE;
+    // every instance of a module has the same subtree, so checking the first one is enough
+    auto root = mod_it->second.front();
+    auto const &targets = target_it->second;
+    auto it = std::lower_bound(targets.begin(), targets.end(), root);
+    if (it == targets.end() || *it >= nodes_[root].end) return NONE;
+    return *it;
+}
+
+bool HierarchyIndex::contains(const ModuleInfo *module, const ModuleInfo *target) const {
+    return module == target || find_descendant(module, target) != NONE;
+}
+
+ModuleInfo *HierarchyIndex::parent(const ModuleInfo *module) const {
+    auto it = parents_.find(module);
+    return it == parents_.end() ? nullptr : it->second;
+}
+
+const std::string &HierarchyIndex::instance_prefix(const ModuleInfo *module,
+                                                   const ModuleInfo *target) {
+    auto key = std::make_pair(module, target);
+    auto it = prefixes_.find(key);
+    if (it != prefixes_.end()) return it->second;
+
+    auto &prefix = prefixes_[key];
+    auto node = find_descendant(module, target);
+    if (node == NONE) return prefix;
+    auto root = occurrences_.at(module).front();
+    std::vector<const std::string *> names;
+    for (; node != root; node = nodes_[node].parent) {
+        names.emplace_back(&nodes_[node].instance_name);
+    }
+    for (auto n = names.rbegin(); n != names.rend(); n++) {
+        prefix.append(**n).append(".");
+    }
+    return prefix;
 }
 
 bool Context::has_module(const std::string &name) {
@@ -810,15 +1082,83 @@ void Context::set_rtl_info(
     const std::unordered_map<std::string, std::unordered_map<std::string, uint32_t>> &signals,
     const std::unordered_map<std::string, std::unordered_map<std::string, std::string>>
         &instances) {
-    info_.signals = signals;
-    info_.instances = instances;
+    RTLTableWriter writer;
     for (auto const &[module_name, ss] : signals) {
-        if (module_infos_.find(module_name) == module_infos_.end()) continue;
-        auto &info = module_infos_.at(module_name);
         for (auto const &[name, width] : ss) {
-            info->signals.emplace(name, SignalInfo(name, width));
+            writer.add_signal(module_name, name, width);
+        }
+    }
+    for (auto const &[parent, children] : instances) {
+        for (auto const &[inst_name, definition] : children) {
+            writer.add_instance(parent, inst_name, definition);
+        }
+    }
+    set_rtl_table(writer.data());
+}
+
+void Context::set_rtl_table(std::string_view table) { info_.load(table); }
+
+void RTLInfo::load(std::string_view table) {
+    // make sure the table is valid before anything is replaced
+    [[maybe_unused]] RTLTableView check(table);
+    table_ = std::string(table);
+    RTLTableView view(table_);
+
+    signals_.clear();
+    instances_.clear();
+    sorted_signals_.clear();
+    parents_.clear();
+    for (auto i = 0u; i < view.num_signals(); i++) {
+        auto signal = view.signal(i);
+        if (signals_[signal.module].emplace(signal.name, signal.width).second) {
+            sorted_signals_[signal.module].emplace_back(signal.name);
+        }
+    }
+    for (auto &[module_name, names] : sorted_signals_) {
+        std::sort(names.begin(), names.end());
+    }
+
+    for (auto i = 0u; i < view.num_instances(); i++) {
+        auto inst = view.instance(i);
+        if (instances_[inst.parent].emplace(inst.name, inst.definition).second) {
+            parents_[inst.definition].emplace_back(inst.parent);
         }
     }
+    for (auto &[definition, parents] : parents_) {
+        std::sort(parents.begin(), parents.end());
+        parents.erase(std::unique(parents.begin(), parents.end()), parents.end());
+    }
+}
+
+std::optional<std::string_view> RTLInfo::find_signal_with_prefix(std::string_view module_name,
+                                                                 std::string_view prefix) const {
+    auto it = sorted_signals_.find(module_name);
+    if (it == sorted_signals_.end()) return std::nullopt;
+    auto const &names = it->second;
+    // every name with the prefix sorts right after the prefix itself
+    auto pos = std::lower_bound(names.begin(), names.end(), prefix);
+    if (pos == names.end() || pos->substr(0, prefix.size()) != prefix) return std::nullopt;
+    return *pos;
+}
+
+bool RTLInfo::has_signal(std::string_view module_name, std::string_view name) const {
+    auto it = signals_.find(module_name);
+    return it != signals_.end() && it->second.find(name) != it->second.end();
+}
+
+const std::vector<std::string_view> &RTLInfo::parent_modules(std::string_view definition) const {
+    static const std::vector<std::string_view> empty;
+    auto it = parents_.find(definition);
+    return it == parents_.end() ? empty : it->second;
+}
+
+std::optional<std::string_view> RTLInfo::find_instance_definition(
+    std::string_view parent, std::string_view instance_name) const {
+    auto it = instances_.find(parent);
+    if (it == instances_.end()) return std::nullopt;
+    auto inst = it->second.find(instance_name);
+    if (inst == it->second.end()) return std::nullopt;
+    return inst->second;
 }
 
 void StateInfo::add_instruction(const std::string &filename, uint32_t line) {
@@ -838,63 +1178,17 @@ void merge_scope(Scope *parent, Scope *child) {
     if (!child_module || !parent_module)
         throw std::runtime_error("Top-level scope cannot have null module");
 
-    // compute instance prefix
-    // BFS with prefix in a map. probably the same memory size if implemented as a recursion
-    std::queue<ModuleInfo *> mods;
-    mods.push(parent_module);
-    std::unordered_map<ModuleInfo *, std::pair<std::string, ModuleInfo *>> hierarchy;
-
-    while (!mods.empty()) {
-        auto *module = mods.front();
-        mods.pop();
-        for (auto [name, m] : module->instances) {
-            hierarchy[m.get()] = std::make_pair(name, module);
-            if (m.get() == child_module) {
-                break;
-            }
-            mods.emplace(m.get());
-        }
-    }
-
-    std::stack<std::string> prefixes;
-    {
-        auto *module = child_module;
-        while (hierarchy.find(module) != hierarchy.end()) {
-            auto [n, p] = hierarchy.at(module);
-            prefixes.emplace(n);
-            module = p;
-        }
-    }
-    std::string prefix;
-    while (!prefixes.empty()) {
-        auto const &n = prefixes.top();
-        prefix.append(n).append(".");
-        prefixes.pop();
-    }
+    auto const &prefix = parent->context->hierarchy().instance_prefix(parent_module, child_module);
 
     // fix all the variable declaration
 
-    {
-        std::queue<Scope *> scopes;
-        scopes.push(new_child);
-
-        while (!scopes.empty()) {
-            auto *s = scopes.front();
-            scopes.pop();
-            if (s->type() == "decl") {
-                // rename it
-                auto *var_scope = reinterpret_cast<DeclInstruction *>(s);
-                var_scope->var.rtl = prefix + var_scope->var.rtl;
-            }
-            for (auto *scope : s->scopes) {
-                scopes.push(scope);
-            }
-        }
-    }
+    new_child->visit<DeclInstruction>(
+        [&prefix](DeclInstruction *decl) { decl->var.rtl = prefix + decl->var.rtl; });
 
     // merge the child into parent
+    auto prefix_symbol = parent->context->intern(prefix);
     for (auto *s : new_child->scopes) {
-        s->instance_prefix = prefix;
+        s->instance_prefix = prefix_symbol;
         parent->add_scope(s);
     }
     new_child->scopes.clear();
@@ -905,19 +1199,8 @@ Scope *find_parent(const std::vector<Scope *> &scopes) {
     if (scopes.empty()) return nullptr;
     auto *scope = scopes[0];
     auto *mod = scope->module;
-    ModuleInfo *parent_module = nullptr;
-    auto const &module_infos = scope->context->module_infos();
-    for (auto const &[name, module] : module_infos) {
-        // just need to find one
-        // assuming there is no duplicated basic block split out
-        if (parent_module) break;
-        for (auto const &[inst_name, inst] : module->instances) {
-            if (inst.get() == mod) {
-                parent_module = module.get();
-                break;
-            }
-        }
-    }
+    // assuming there is no duplicated basic block split out
+    auto *parent_module = scope->context->hierarchy().parent(mod);
     if (!parent_module) throw std::runtime_error("Unable to find module for scope");
     auto *res = parent_module->root_scope;
     // make sure it contains
@@ -964,14 +1247,69 @@ void merge_scopes(const std::map<std::string, std::vector<Scope *>> &scopes) {
     }
 }
 
+FunctionRangeIndex::FunctionRangeIndex(
+    const std::map<std::string, std::pair<uint32_t, uint32_t>> &functions) {
+    // sweep over the range boundaries. active functions are ordered by the innermost policy so
+    // the owner of each segment is simply the first active one
+    using Active = std::pair<uint64_t, const std::string *>;
+    auto innermost = [](const Active &a, const Active &b) {
+        return a.first != b.first ? a.first < b.first : *a.second < *b.second;
+    };
+    std::set<Active, decltype(innermost)> active(innermost);
+    // (line, is_start, function). ends are exclusive and sort before starts on the same line
+    std::vector<std::tuple<uint64_t, bool, Active>> events;
+    events.reserve(functions.size() * 2);
+    for (auto const &[name, range] : functions) {
+        auto const [min, max] = range;
+        if (min > max) continue;
+        Active entry(static_cast<uint64_t>(max) - min, &name);
+        events.emplace_back(min, true, entry);
+        events.emplace_back(static_cast<uint64_t>(max) + 1, false, entry);
+    }
+    std::sort(events.begin(), events.end(), [](auto const &a, auto const &b) {
+        return std::get<0>(a) != std::get<0>(b) ? std::get<0>(a) < std::get<0>(b)
+                                                : std::get<1>(a) < std::get<1>(b);
+    });
+
+    for (auto i = 0u; i < events.size();) {
+        auto line = std::get<0>(events[i]);
+        for (; i < events.size() && std::get<0>(events[i]) == line; i++) {
+            auto const &[l, is_start, entry] = events[i];
+            if (is_start) {
+                active.emplace(entry);
+            } else {
+                active.erase(entry);
+            }
+        }
+        auto const *owner = active.empty() ? nullptr : active.begin()->second;
+        if (!owners_.empty() && owners_.back() == owner) continue;
+        // lines past uint32_t max cannot be queried anyway
+        if (line > std::numeric_limits<uint32_t>::max()) break;
+        starts_.emplace_back(static_cast<uint32_t>(line));
+        owners_.emplace_back(owner);
+    }
+}
+
+const std::string *FunctionRangeIndex::find(uint32_t line) const {
+    auto it = std::upper_bound(starts_.begin(), starts_.end(), line);
+    if (it == starts_.begin()) return nullptr;
+    return owners_[std::distance(starts_.begin(), it) - 1];
+}
+
 std::map<std::string, Scope *> reorganize_scopes(
-    const llvm::Module *module,
     const std::map<std::string, std::map<std::string, std::pair<uint32_t, uint32_t>>>
         &original_functions,
     std::map<std::string, Scope *> scopes) {
     // we first sort through the scopes. i.e. put them into different buckets
     std::map<std::string, std::vector<Scope *>> function_scopes;
 
+    // keys point into original_functions
+    std::unordered_map<std::string_view, FunctionRangeIndex> function_ranges;
+    function_ranges.reserve(original_functions.size());
+    for (auto const &[filename, functions] : original_functions) {
+        function_ranges.emplace(filename, FunctionRangeIndex(functions));
+    }
+
     for (auto const &[mod_name, scope] : scopes) {
         auto child_scopes = scope->scopes;
         scope->scopes.clear();
@@ -982,38 +1320,32 @@ std::map<std::string, Scope *> reorganize_scopes(
         std::string targeted_function_name;
 
         for (auto *child_scope : child_scopes) {
-            auto filename = child_scope->get_filename();
-            if (original_functions.find(filename) == original_functions.end()) {
-                throw std::runtime_error("Unable to determine location for file " + filename);
+            auto filename = child_scope->context->str(child_scope->get_filename());
+            auto ranges = function_ranges.find(filename);
+            if (ranges == function_ranges.end()) {
+                throw std::runtime_error("Unable to determine location for file " +
+                                         std::string(filename));
             }
-            auto const &function_range = original_functions.at(filename);
             auto line = child_scope->line;
             if (line == 0) {
                 escaped_scopes.emplace_back(child_scope);
                 continue;
             }
-            bool found = false;
-            for (auto const &[func_name, line_range] : function_range) {
-                auto const [min, max] = line_range;
-                if (line >= min && line <= max) {
-                    found = true;
-
-                    if (mod_functions.find(func_name) == mod_functions.end()) {
-                        auto *new_scope = scope->context->add_scope<Scope>(scope);
-                        new_scope->module = scope->module;
-                        mod_functions.emplace(func_name, new_scope);
-                        function_scopes[func_name].emplace_back(new_scope);
-                    }
-
-                    auto *function_scope = mod_functions.at(func_name);
-                    function_scope->add_scope(child_scope);
-                    targeted_function_name = func_name;
-                }
+            auto const *func_name = ranges->second.find(line);
+            if (!func_name) {
+                throw std::runtime_error("Unable to determine scope location");
             }
 
-            if (!found) {
-                throw std::runtime_error("Unable to determine scope location");
+            if (mod_functions.find(*func_name) == mod_functions.end()) {
+                auto *new_scope = scope->context->add_scope<Scope>(scope);
+                new_scope->module = scope->module;
+                mod_functions.emplace(*func_name, new_scope);
+                function_scopes[*func_name].emplace_back(new_scope);
             }
+
+            auto *function_scope = mod_functions.at(*func_name);
+            function_scope->add_scope(child_scope);
+            targeted_function_name = *func_name;
         }
         // just use the last one. we don't expect the split function comes from two functions
         for (auto *s : escaped_scopes) {
@@ -1052,7 +1384,7 @@ void infer_dandling_scope_state(Scope *scope) {
 
     bool target = true;
     for (auto *s : scope->scopes) {
-        if (s->type() == "block") {
+        if (s->kind() == ScopeKind::Block) {
             target = false;
             break;
         }
@@ -1060,13 +1392,13 @@ void infer_dandling_scope_state(Scope *scope) {
     if (!target || scope->scopes.size() <= 1) return;
     // check if there is any missing state info
     uint64_t max_state_size = 0;
-    std::string state_id_name;
-    std::string prefix;
+    auto state_id_name = EMPTY_SYMBOL;
+    auto prefix = EMPTY_SYMBOL;
     for (auto *s : scope->scopes) {
         auto size = s->state_ids.size();
         if (size > max_state_size) max_state_size = size;
         if (size == 1) {
-            if (state_id_name.empty()) {
+            if (state_id_name == EMPTY_SYMBOL) {
                 state_id_name = s->state_ids[0];
                 prefix = s->instance_prefix;
             } else if (state_id_name != s->state_ids[0] || prefix != s->instance_prefix) {
@@ -1082,7 +1414,7 @@ void infer_dandling_scope_state(Scope *scope) {
     // fixing state ids and prefix
     for (auto *s : scope->scopes) {
         if (s->state_ids.empty()) {
-            if (state_id_name.empty()) {
+            if (state_id_name == EMPTY_SYMBOL) {
                 throw std::runtime_error("State id should not be empty when infer dangling state");
             }
             s->state_ids.emplace_back(state_id_name);
@@ -1100,7 +1432,8 @@ void infer_dangling_scope_state(const std::map<std::string, Scope *> &scopes) {
 void infer_function_arg(const llvm::Module *module, const std::map<std::string, Scope *> &scopes) {
     for (auto const &[func_name, root_scope] : scopes) {
         auto *function = module->getFunction(func_name);
-        // loop through each argument and see if they're called via args that has a debug declare
+        // loop through each argument and see if they're called via args that has a debug declare.
+        // with lazy loading, use_begin() only sees the callers whose bodies have been materialized
         for (auto function_use = function->use_begin(); function_use != function->use_end();
              function_use++) {
             if (auto *func_call = llvm::dyn_cast<llvm::CallInst>(*function_use)) {
@@ -1124,18 +1457,7 @@ void infer_function_arg(const llvm::Module *module, const std::map<std::string,
                     if (debug_instructions.find(called_arg) != debug_instructions.end()) {
                         auto *call_instr = debug_instructions.at(called_arg);
                         auto &context = *root_scope->context;
-                        // find parent
-                        ModuleInfo *mod = nullptr;
-                        for (auto const &[name, m] : context.module_infos()) {
-                            for (auto const &[i, def] : m->instances) {
-                                if (def.get() == root_scope->module) {
-                                    mod = m.get();
-                                    break;
-                                }
-                            }
-                            if (mod) break;
-                        }
-
+                        auto *mod = context.hierarchy().parent(root_scope->module);
                         if (!mod)
                             throw std::runtime_error(
                                 "Unable to find parent module to infer function arg");
@@ -1149,14 +1471,24 @@ void infer_function_arg(const llvm::Module *module, const std::map<std::string,
     }
 }
 
+void release_llvm_bitcode(Context &context, llvm::Module *module) {
+    if (!module) return;
+    for (auto &[name, info] : context.module_infos()) {
+        if (info->function && info->function->getParent() == module) info->function = nullptr;
+    }
+    auto *llvm_context = &module->getContext();
+    delete module;
+    delete llvm_context;
+}
+
 void inject_function_args(
-    const std::unordered_map<std::string, uint32_t> &signals, const std::string &module_name,
-    Scope &scope,
+    const std::string &module_name, Scope &scope,
     const std::vector<std::tuple<std::string, uint32_t, std::vector<uint32_t>>> &var_infos) {
+    auto const &rtl_info = scope.context->rtl_info();
     for (auto const &[name, line, vars] : var_infos) {
         if (!vars.empty()) continue;
         // for now, we're only interested in scalar values
-        if (signals.find(name) == signals.end()) continue;
+        if (!rtl_info.has_signal(module_name, name)) continue;
         Variable v{name, name};
         // if the parent only has one scope, add declare scope to the only child
         auto *target_scope = &scope;
@@ -1174,6 +1506,7 @@ void ModuleInfo::add_instance(const std::string &m_name, const std::string &inst
     }
     auto module = context->get_module(m_name);
     instances.emplace(instance_name, module);
+    context->invalidate_hierarchy();
 }
 
 // NOLINTNEXTLINE
@@ -1187,6 +1520,7 @@ void ModuleInfo::remove_definition(const std::string &target_module_name) {
     for (auto const &n : insts) {
         instances.erase(n);
     }
+    if (!insts.empty() && context) context->invalidate_hierarchy();
 
     // recursively remove stuff
     for (auto const &[n, mod] : instances) {
@@ -1,10 +1,19 @@
 #ifndef HGDB_VITIS_IR_HH
 #define HGDB_VITIS_IR_HH
 
+#include <deque>
+#include <limits>
 #include <map>
 #include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <optional>
+#include <ostream>
 #include <set>
+#include <shared_mutex>
 #include <string>
+#include <string_view>
+#include <unordered_map>
 #include <unordered_set>
 #include <utility>
 #include <vector>
@@ -25,8 +34,11 @@ std::map<std::string, std::map<uint32_t, std::vector<const llvm::Instruction *>>
 
 std::set<std::string> get_contained_functions(const llvm::Function *function);
 
+// materializes every function in the module, which undoes lazy loading. the driver only loads
+// what get_contained_functions reaches from the top. num_threads = 0 uses all hardware threads
 std::map<std::string, const llvm::Function *> get_optimized_functions(
-    const llvm::Module *module, const std::set<std::string> &function_names);
+    const llvm::Module *module, const std::set<std::string> &function_names,
+    uint32_t num_threads = 1);
 
 std::string get_demangled_name(const llvm::Function *function);
 
@@ -36,7 +48,11 @@ const llvm::Instruction *get_pre_alloc(const llvm::Instruction *instruction);
 
 std::string guess_rtl_name(const llvm::Instruction *instruction);
 
-llvm::Module *parse_llvm_bitcode(const std::string &path);
+// when lazy is set, function bodies are only read in once they are materialized. every module
+// gets its own LLVMContext, so modules can be parsed concurrently and freed independently
+llvm::Module *parse_llvm_bitcode(const std::string &path, bool lazy = false);
+
+bool materialize(const llvm::Function *function);
 
 // debugging scopes
 struct Variable {
@@ -59,22 +75,81 @@ struct StateInfo {
     void add_instruction(const std::string &filename, uint32_t line);
 };
 
-struct SignalInfo {
-    std::string name;
-    uint32_t width;
-
-    SignalInfo(std::string name, uint32_t width) : name(std::move(name)), width(width) {}
-};
-
 struct SerializationOptions {
     std::map<std::string, std::string> remap_filename;
 
     void add_mapping(const std::string &before, std::string &after);
 };
 
+std::string remap_filename(const std::string &filename, const SerializationOptions &options);
+
 class Scope;
 class Context;
 
+// allocates from an arena (or the heap if none is given). unlike std::pmr::polymorphic_allocator
+// it propagates on move assignment, which is how ScopeArena hands a new node its children list.
+// copy assignment keeps the destination's arena: the source may belong to another thread's arena,
+// which is not thread-safe
+template <typename T>
+class ArenaAllocator {
+public:
+    using value_type = T;
+    using propagate_on_container_copy_assignment = std::false_type;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap = std::true_type;
+
+    ArenaAllocator() = default;
+    explicit ArenaAllocator(std::pmr::memory_resource *resource) : resource_(resource) {}
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U> &other) : resource_(other.resource()) {}  // NOLINT
+
+    T *allocate(std::size_t n) {
+        return static_cast<T *>(resource()->allocate(n * sizeof(T), alignof(T)));
+    }
+    void deallocate(T *p, std::size_t n) { resource()->deallocate(p, n * sizeof(T), alignof(T)); }
+
+    [[nodiscard]] inline std::pmr::memory_resource *resource() const {
+        return resource_ ? resource_ : std::pmr::new_delete_resource();
+    }
+
+    template <typename U>
+    bool operator==(const ArenaAllocator<U> &other) const {
+        return resource() == other.resource();
+    }
+    template <typename U>
+    bool operator!=(const ArenaAllocator<U> &other) const {
+        return !(*this == other);
+    }
+
+private:
+    std::pmr::memory_resource *resource_ = nullptr;
+};
+
+using ScopeList = std::vector<Scope *, ArenaAllocator<Scope *>>;
+
+enum class ScopeKind : uint8_t { Block, Instruction, Decl };
+
+// names used in the symbol table
+constexpr std::string_view scope_kind_name(ScopeKind kind) {
+    switch (kind) {
+        case ScopeKind::Block:
+            return "block";
+        case ScopeKind::Instruction:
+            return "none";
+        case ScopeKind::Decl:
+            return "decl";
+    }
+    return {};
+}
+
+// id of a string interned in the context's StringPool
+using Symbol = uint32_t;
+// always the empty string
+constexpr Symbol EMPTY_SYMBOL = 0;
+
+// line -> scopes
+using LineScopes = std::unordered_map<uint32_t, std::vector<Scope *>>;
+
 struct ModuleInfo {
     std::string module_name;
 
@@ -82,7 +157,6 @@ struct ModuleInfo {
 
     // we assume that the xrf files contain the signals that used for controlling the states
     std::map<std::string, StateInfo> state_infos;
-    std::map<std::string, SignalInfo> signals;
 
     std::map<std::string, std::shared_ptr<ModuleInfo>> instances;
 
@@ -100,57 +174,112 @@ struct ModuleInfo {
 
 class Scope {
 public:
-    std::vector<Scope *> scopes;
-    std::string filename;
-    std::string raw_filename;
+    ScopeList scopes;
+    // strings are interned in the context, see Context::str
+    Symbol filename = EMPTY_SYMBOL;
+    Symbol raw_filename = EMPTY_SYMBOL;
     uint32_t line = 0;
 
     // one single line can have multiple ids
-    std::vector<std::string> state_ids;
-    const llvm::Instruction *instruction = nullptr;
+    std::vector<Symbol> state_ids;
     // used to indicating scoping changes (moved up)
-    std::string instance_prefix;
+    Symbol instance_prefix = EMPTY_SYMBOL;
 
     Scope *parent_scope;
     ModuleInfo *module = nullptr;
     Context *context = nullptr;
 
-    explicit Scope(Scope *parent_scope) : parent_scope(parent_scope) {}
+    explicit Scope(Scope *parent_scope) : Scope(parent_scope, ScopeKind::Block) {}
 
-    [[nodiscard]] virtual std::string type() const { return "block"; }
+    [[nodiscard]] inline ScopeKind kind() const { return kind_; }
+    [[nodiscard]] inline std::string_view type() const { return scope_kind_name(kind_); }
 
-    [[nodiscard]] std::string serialize(const SerializationOptions &options) const;
+    // LLVM-style type checks without RTTI or string compares
+    static constexpr bool classof(ScopeKind) { return true; }
+    template <typename T>
+    [[nodiscard]] bool is() const {
+        return T::classof(kind_);
+    }
+    template <typename T>
+    T *as() {
+        return is<T>() ? static_cast<T *>(this) : nullptr;
+    }
+    template <typename T>
+    const T *as() const {
+        return is<T>() ? static_cast<const T *>(this) : nullptr;
+    }
 
-    Scope *find(const std::function<bool(Scope *)> &predicate);
-    void find_all(const std::function<bool(Scope *)> &predicate, std::vector<Scope *> &res);
+    [[nodiscard]] std::string serialize(const SerializationOptions &options) const;
+    void serialize(std::ostream &stream, const SerializationOptions &options) const;
+    // enable condition of the scope. empty for blocks without state information
+    [[nodiscard]] std::string condition() const;
+    void write_condition(std::ostream &stream) const;
+
+    template <typename F>
+    Scope *find(F &&predicate) {  // NOLINT
+        if (predicate(this)) return this;
+        for (auto *s : scopes) {
+            if (auto *p = s->find(predicate)) return p;
+        }
+        return nullptr;
+    }
+    template <typename F>
+    void find_all(F &&predicate, std::vector<Scope *> &res) {  // NOLINT
+        if (predicate(this)) res.emplace_back(this);
+        for (auto *s : scopes) {
+            s->find_all(predicate, res);
+        }
+    }
+    // pre-order traversal that only calls the visitor on scopes of type T
+    template <typename T = Scope, typename F>
+    void visit(F &&visitor) {  // NOLINT
+        if (auto *s = as<T>()) visitor(s);
+        for (auto *s : scopes) {
+            s->visit<T>(visitor);
+        }
+    }
     void bind_state(ModuleInfo &module);
     void add_scope(Scope *scope);
     void remove_from_parent();
     void clear_empty();
     [[nodiscard]] bool contains(const Scope *scope) const;
 
-    [[nodiscard]] std::string get_filename() const;
-    [[nodiscard]] std::string get_raw_filename() const;
+    // inherited from the parent scopes if not set
+    [[nodiscard]] Symbol get_filename() const;
+    [[nodiscard]] Symbol get_raw_filename() const;
 
     [[nodiscard]] virtual Scope *copy() const;
 
     virtual ~Scope() = default;
 
+protected:
+    Scope(Scope *parent_scope, ScopeKind kind) : parent_scope(parent_scope), kind_(kind) {}
+
 private:
-    [[nodiscard]] virtual std::string serialize_member() const { return {}; }
+    ScopeKind kind_;
+
+    virtual void serialize_member(std::ostream &) const {}
 
     void set_module(ModuleInfo *mod);
 };
 
 class Instruction : public Scope {
 public:
-    Instruction(Scope *parent_scope, uint32_t line) : Scope(parent_scope) { this->line = line; }
+    Instruction(Scope *parent_scope, uint32_t line)
+        : Instruction(parent_scope, line, ScopeKind::Instruction) {}
 
-    [[nodiscard]] std::string type() const override { return "none"; }
+    static constexpr bool classof(ScopeKind kind) {
+        return kind == ScopeKind::Instruction || kind == ScopeKind::Decl;
+    }
 
-    [[nodiscard]] std::string serialize_member() const override;
+    void serialize_member(std::ostream &stream) const override;
 
     [[nodiscard]] Scope *copy() const override;
+
+protected:
+    Instruction(Scope *parent_scope, uint32_t line, ScopeKind kind) : Scope(parent_scope, kind) {
+        this->line = line;
+    }
 };
 
 class DeclInstruction : public Instruction {
@@ -159,30 +288,186 @@ public:
     Variable var;
 
     DeclInstruction(Scope *parent_scope, Variable var, uint32_t line)
-        : Instruction(parent_scope, line), var(std::move(var)) {}
+        : Instruction(parent_scope, line, ScopeKind::Decl), var(std::move(var)) {}
 
-    [[nodiscard]] std::string type() const override { return "decl"; }
+    static constexpr bool classof(ScopeKind kind) { return kind == ScopeKind::Decl; }
 
-    [[nodiscard]] std::string serialize_member() const override;
+    void serialize_member(std::ostream &stream) const override;
 
     [[nodiscard]] Scope *copy() const override;
 };
 
-struct RTLInfo {
-    std::unordered_map<std::string, std::unordered_map<std::string, uint32_t>> signals;
-    std::unordered_map<std::string, std::unordered_map<std::string, std::string>> instances;
+// resolves (filename, directory) pairs from the debug info into canonical paths. every distinct
+// pair only touches the file system once and maps to a canonical file id. safe to use from
+// multiple threads
+class FilenameResolver {
+public:
+    uint32_t resolve(const std::string &filename, const std::string &directory);
+    // references stay valid for the lifetime of the resolver
+    [[nodiscard]] const std::string &filename(uint32_t id) const;
+
+    [[nodiscard]] uint64_t num_lookups() const;
+    [[nodiscard]] uint64_t num_files() const;
+    // estimated as one stat/readlink per path component for every resolution skipped
+    [[nodiscard]] uint64_t saved_syscalls() const;
+
+private:
+    struct Entry {
+        uint32_t id;
+        uint32_t cost;
+    };
+    mutable std::mutex mutex_;
+    std::unordered_map<std::string, Entry> entries_;
+    std::unordered_map<std::string, uint32_t> canonical_ids_;
+    std::deque<std::string> filenames_;
+
+    uint64_t num_lookups_ = 0;
+    uint64_t saved_syscalls_ = 0;
+};
+
+// hands out a 32-bit symbol for every distinct string, so duplicated names are stored once and
+// compared as integers. safe to use from multiple threads
+class StringPool {
+public:
+    StringPool();
+
+    Symbol intern(std::string_view value);
+    // does not add the value if it's not in the pool yet
+    [[nodiscard]] std::optional<Symbol> find(std::string_view value) const;
+    // views stay valid for the lifetime of the pool
+    [[nodiscard]] std::string_view str(Symbol symbol) const;
+    [[nodiscard]] uint64_t size() const;
+
+private:
+    mutable std::shared_mutex mutex_;
+    std::deque<std::string> strings_;
+    std::unordered_map<std::string_view, Symbol> symbols_;
+};
+
+// owns scopes allocated by one thread. nodes and their children lists live in the arena, so
+// the memory is released all at once when the arena goes away
+class ScopeArena {
+public:
+    ScopeArena() = default;
+    ScopeArena(const ScopeArena &) = delete;
+    ScopeArena &operator=(const ScopeArena &) = delete;
+    ~ScopeArena();
+
+    template <typename T, typename... Args>
+    T *create(Scope *parent_scope, Args... args) {
+        auto *entry = new (resource_.allocate(sizeof(T), alignof(T))) T(parent_scope, args...);
+        entry->scopes = ScopeList(ArenaAllocator<Scope *>(&resource_));
+        scopes_.emplace_back(entry);
+        return entry;
+    }
+
+    // calls the destructor of every scope created so far
+    void clear();
+
+private:
+    std::pmr::monotonic_buffer_resource resource_{1 << 16};
+    std::vector<Scope *> scopes_;
+};
+
+// instance hierarchy unrolled from the modules that are not instantiated anywhere. every node is
+// one instance, so a module instantiated several times owns several nodes. nodes are numbered in
+// DFS order, which makes every subtree a contiguous [begin, end) range of node ids
+class HierarchyIndex {
+public:
+    explicit HierarchyIndex(const std::map<std::string, std::shared_ptr<ModuleInfo>> &modules);
+
+    // true if target is the module itself or instantiated anywhere below it
+    [[nodiscard]] bool contains(const ModuleInfo *module, const ModuleInfo *target) const;
+    // first module (in module name order) that instantiates the module. null for top modules
+    [[nodiscard]] ModuleInfo *parent(const ModuleInfo *module) const;
+    // instance path from module down to target, e.g. "grp_a_fu_10.grp_b_fu_20.". empty when
+    // target is not below module
+    const std::string &instance_prefix(const ModuleInfo *module, const ModuleInfo *target);
+
+    [[nodiscard]] inline uint64_t size() const { return nodes_.size(); }
+
+private:
+    static constexpr uint32_t NONE = std::numeric_limits<uint32_t>::max();
+    struct Node {
+        const ModuleInfo *module;
+        std::string instance_name;
+        uint32_t parent;
+        uint32_t end;
+    };
+    std::vector<Node> nodes_;
+    // module -> node ids in ascending order
+    std::unordered_map<const ModuleInfo *, std::vector<uint32_t>> occurrences_;
+    std::unordered_map<const ModuleInfo *, ModuleInfo *> parents_;
+    std::map<std::pair<const ModuleInfo *, const ModuleInfo *>, std::string> prefixes_;
+
+    uint32_t add_node(const ModuleInfo *module, const std::string &instance_name, uint32_t parent);
+    [[nodiscard]] uint32_t find_descendant(const ModuleInfo *module,
+                                           const ModuleInfo *target) const;
+};
+
+class RTLInfo {
+public:
+    // names point into the RTL table the info keeps a copy of
+    using SignalMap = std::unordered_map<std::string_view, uint32_t>;
+    using InstanceMap = std::unordered_map<std::string_view, std::string_view>;
+
+    // replaces everything with the content of a table from rtl_table.hh. throws on malformed
+    // tables
+    void load(std::string_view table);
+
+    [[nodiscard]] inline const std::unordered_map<std::string_view, SignalMap> &signals() const {
+        return signals_;
+    }
+    [[nodiscard]] inline const std::unordered_map<std::string_view, InstanceMap> &instances()
+        const {
+        return instances_;
+    }
+    [[nodiscard]] inline const std::string &table() const { return table_; }
+
+    // lexicographically smallest signal in the module that starts with prefix
+    [[nodiscard]] std::optional<std::string_view> find_signal_with_prefix(
+        std::string_view module_name, std::string_view prefix) const;
+    [[nodiscard]] bool has_signal(std::string_view module_name, std::string_view name) const;
+
+    // modules that instantiate the definition, in ascending order
+    [[nodiscard]] const std::vector<std::string_view> &parent_modules(
+        std::string_view definition) const;
+    // definition of an instance inside the parent module
+    [[nodiscard]] std::optional<std::string_view> find_instance_definition(
+        std::string_view parent, std::string_view instance_name) const;
+
+private:
+    std::string table_;
+    std::unordered_map<std::string_view, SignalMap> signals_;
+    std::unordered_map<std::string_view, InstanceMap> instances_;
+    // module -> signal names in ascending order
+    std::unordered_map<std::string_view, std::vector<std::string_view>> sorted_signals_;
+    // definition -> parent modules in ascending order
+    std::unordered_map<std::string_view, std::vector<std::string_view>> parents_;
 };
 
 class Context {
 public:
+    Context() = default;
+    Context(const Context &) = delete;
+    Context &operator=(const Context &) = delete;
+    ~Context();
+
     template <typename T, typename... Args>
     T *add_scope(Scope *parent_scope, Args... args) {
-        auto entry = std::make_unique<T>(parent_scope, args...);
-        if (parent_scope) parent_scope->scopes.emplace_back(entry.get());
+        auto *entry = arena().create<T>(parent_scope, args...);
+        if (parent_scope) parent_scope->scopes.emplace_back(entry);
         entry->context = this;
-        return reinterpret_cast<T *>(scopes_.emplace_back(std::move(entry)).get());
+        return entry;
     }
 
+    // arena used by add_scope on the calling thread
+    ScopeArena &arena();
+    // extra arena for a worker thread. it lives as long as the context does
+    ScopeArena *add_arena();
+    // scopes created by the calling thread go into the arena until it is unbound with null
+    void bind_thread_arena(ScopeArena *arena);
+
     std::shared_ptr<ModuleInfo> get_module(const std::string &name);
     void add_module(const std::string &name, std::shared_ptr<ModuleInfo> mod);
     [[nodiscard]] bool has_module(const std::string &name);
@@ -202,31 +487,74 @@ public:
         const std::unordered_map<std::string, std::unordered_map<std::string, uint32_t>> &signals,
         const std::unordered_map<std::string, std::unordered_map<std::string, std::string>>
             &instances);
+    // same as above, but takes the flat table produced by vitis_rtl so nothing has to be
+    // converted to Python objects on the way
+    void set_rtl_table(std::string_view table);
 
     inline RTLInfo &rtl_info() { return info_; }
+    inline StringPool &strings() { return strings_; }
+    inline Symbol intern(std::string_view value) { return strings_.intern(value); }
+    [[nodiscard]] inline std::string_view str(Symbol symbol) const { return strings_.str(symbol); }
+    inline FilenameResolver &filename_resolver() { return filename_resolver_; }
+    // built on first use and dropped whenever the instance hierarchy changes
+    HierarchyIndex &hierarchy();
+    inline void invalidate_hierarchy() { hierarchy_.reset(); }
 
     std::string top_name;
 
 private:
-    std::vector<std::unique_ptr<Scope>> scopes_;
+    ScopeArena arena_;
+    std::vector<std::unique_ptr<ScopeArena>> thread_arenas_;
     std::map<std::string, std::shared_ptr<ModuleInfo>> module_infos_;
     RTLInfo info_;
+    StringPool strings_;
+    FilenameResolver filename_resolver_;
+    std::unique_ptr<HierarchyIndex> hierarchy_;
 };
 
 Scope *get_debug_scope(const llvm::Function *function, Context &context, ModuleInfo *module);
 
+// get_debug_scope + bind_state for every module, spread over num_threads workers (0 uses all
+// hardware threads). results are keyed by module name and do not depend on the scheduling
+std::map<std::string, Scope *> build_module_scopes(
+    Context &context, const std::map<std::string, std::shared_ptr<ModuleInfo>> &modules,
+    uint32_t num_threads);
+
+// maps source lines of one file to the function that owns them. when function ranges overlap the
+// innermost one wins, i.e. the one with the smallest line span, with ties broken by name
+class FunctionRangeIndex {
+public:
+    explicit FunctionRangeIndex(
+        const std::map<std::string, std::pair<uint32_t, uint32_t>> &functions);
+
+    // null if no function covers the line
+    [[nodiscard]] const std::string *find(uint32_t line) const;
+
+private:
+    // disjoint segments sorted by their first line. each one lasts until the next one starts
+    std::vector<uint32_t> starts_;
+    std::vector<const std::string *> owners_;
+};
+
 std::map<std::string, Scope *> reorganize_scopes(
-    const llvm::Module *module,
     const std::map<std::string, std::map<std::string, std::pair<uint32_t, uint32_t>>>
         &original_functions,
     std::map<std::string, Scope *> scopes);
 
 void infer_dangling_scope_state(const std::map<std::string, Scope *> &scopes);
 
+// callers are found through use lists. with lazy loading those only contain the calls in bodies
+// that have been materialized
 void infer_function_arg(const llvm::Module *module, const std::map<std::string, Scope *> &scopes);
 
+// frees a module from parse_llvm_bitcode together with its LLVMContext. scopes only hold plain
+// data, so this is safe once they are built and infer_function_arg is done. functions of the
+// module are cleared from the context's modules
+void release_llvm_bitcode(Context &context, llvm::Module *module);
+
+// signals are looked up in the RTL info of the scope's context
 void inject_function_args(
-    const std::unordered_map<std::string, uint32_t> &signals, const std::string &module_name, Scope &scope,
+    const std::string &module_name, Scope &scope,
     const std::vector<std::tuple<std::string, uint32_t, std::vector<uint32_t>>> &var_infos);
 
 #endif  // HGDB_VITIS_IR_HH
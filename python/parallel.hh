@@ -0,0 +1,66 @@
+#ifndef HGDB_VITIS_PARALLEL_HH
+#define HGDB_VITIS_PARALLEL_HH
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// number of workers used for size work items. 0 means one per hardware thread
+inline uint32_t resolve_num_threads(uint32_t num_threads, uint64_t size) {
+    if (num_threads == 0) num_threads = std::max(1u, std::thread::hardware_concurrency());
+    return static_cast<uint32_t>(std::max<uint64_t>(1, std::min<uint64_t>(num_threads, size)));
+}
+
+// calls f(idx) for every idx in [0, size) on resolve_num_threads(num_threads, size) workers.
+// f may also take the worker id in [0, num workers) as a second argument to index per-worker
+// state. items are handed out one at a time so uneven items balance out, and a single worker
+// runs on the calling thread. if items throw, the exception of the lowest index is rethrown once
+// every worker is done, which is the error a sequential run hits first
+template <typename F>
+void parallel_for(uint64_t size, uint32_t num_threads, F &&f) {
+    num_threads = resolve_num_threads(num_threads, size);
+
+    std::atomic<uint64_t> next = 0;
+    std::mutex error_mutex;
+    uint64_t error_idx = size;
+    std::exception_ptr error;
+    auto worker = [&](uint32_t thread_id) {
+        while (true) {
+            auto idx = next.fetch_add(1);
+            if (idx >= size) break;
+            try {
+                if constexpr (std::is_invocable_v<F &, uint64_t, uint32_t>) {
+                    f(idx, thread_id);
+                } else {
+                    f(idx);
+                }
+            } catch (...) {
+                std::lock_guard guard(error_mutex);
+                if (idx < error_idx) {
+                    error_idx = idx;
+                    error = std::current_exception();
+                }
+            }
+        }
+    };
+
+    if (num_threads == 1) {
+        worker(0);
+    } else {
+        std::vector<std::thread> threads;
+        threads.reserve(num_threads);
+        for (auto i = 0u; i < num_threads; i++) {
+            threads.emplace_back(worker, i);
+        }
+        for (auto &t : threads) t.join();
+    }
+
+    if (error) std::rethrow_exception(error);
+}
+
+#endif  // HGDB_VITIS_PARALLEL_HH
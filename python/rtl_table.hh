@@ -0,0 +1,187 @@
+#ifndef HGDB_VITIS_RTL_TABLE_HH
+#define HGDB_VITIS_RTL_TABLE_HH
+
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// flat RTL table handed from vitis_rtl to vitis. the two extension modules are built against
+// different C++ ABIs, so they exchange this byte buffer instead of C++ containers. every integer
+// is a native uint32_t:
+//   magic, version
+//   num_strings, offsets[num_strings + 1], string bytes
+//   num_signals, (module, name, width)[num_signals]
+//   num_instances, (parent, instance name, definition)[num_instances]
+// modules, names and definitions are indices into the string table
+
+constexpr uint32_t RTL_TABLE_MAGIC = 0x4c545248;  // "HRTL"
+constexpr uint32_t RTL_TABLE_VERSION = 1;
+
+class RTLTableWriter {
+public:
+    // duplicated (module, name) pairs are ignored, the first width wins
+    void add_signal(std::string_view module, std::string_view name, uint32_t width) {
+        auto module_id = intern(module);
+        auto name_id = intern(name);
+        if (!signal_keys_.emplace(key(module_id, name_id)).second) return;
+        signals_.insert(signals_.end(), {module_id, name_id, width});
+    }
+
+    // duplicated (parent, instance name) pairs are ignored
+    void add_instance(std::string_view parent, std::string_view name, std::string_view definition) {
+        auto parent_id = intern(parent);
+        auto name_id = intern(name);
+        if (!instance_keys_.emplace(key(parent_id, name_id)).second) return;
+        instances_.insert(instances_.end(), {parent_id, name_id, intern(definition)});
+        modules_with_instances_.emplace(parent_id);
+    }
+
+    [[nodiscard]] bool has_instances(std::string_view module) const {
+        auto it = string_ids_.find(std::string(module));
+        return it != string_ids_.end() &&
+               modules_with_instances_.find(it->second) != modules_with_instances_.end();
+    }
+
+    [[nodiscard]] std::string data() const {
+        std::string res;
+        uint64_t size = 4 * (5 + strings_.size() + 1 + signals_.size() + instances_.size());
+        for (auto const &s : strings_) size += s.size();
+        res.reserve(size);
+
+        auto write = [&res](uint32_t value) {
+            res.append(reinterpret_cast<const char *>(&value), sizeof(value));
+        };
+        write(RTL_TABLE_MAGIC);
+        write(RTL_TABLE_VERSION);
+        write(static_cast<uint32_t>(strings_.size()));
+        uint32_t offset = 0;
+        write(offset);
+        for (auto const &s : strings_) {
+            offset += static_cast<uint32_t>(s.size());
+            write(offset);
+        }
+        for (auto const &s : strings_) res.append(s);
+        write(static_cast<uint32_t>(signals_.size() / 3));
+        for (auto value : signals_) write(value);
+        write(static_cast<uint32_t>(instances_.size() / 3));
+        for (auto value : instances_) write(value);
+        return res;
+    }
+
+private:
+    std::vector<std::string> strings_;
+    std::unordered_map<std::string, uint32_t> string_ids_;
+    std::vector<uint32_t> signals_;
+    std::vector<uint32_t> instances_;
+    std::unordered_set<uint64_t> signal_keys_;
+    std::unordered_set<uint64_t> instance_keys_;
+    std::unordered_set<uint32_t> modules_with_instances_;
+
+    uint32_t intern(std::string_view value) {
+        auto [it, inserted] =
+            string_ids_.emplace(std::string(value), static_cast<uint32_t>(strings_.size()));
+        if (inserted) strings_.emplace_back(value);
+        return it->second;
+    }
+
+    static uint64_t key(uint32_t a, uint32_t b) { return (static_cast<uint64_t>(a) << 32) | b; }
+};
+
+// reads a table in place. the data has to outlive the view
+class RTLTableView {
+public:
+    struct Signal {
+        std::string_view module;
+        std::string_view name;
+        uint32_t width;
+    };
+
+    struct Instance {
+        std::string_view parent;
+        std::string_view name;
+        std::string_view definition;
+    };
+
+    // throws std::runtime_error if the data is not a valid table
+    explicit RTLTableView(std::string_view data) : data_(data) {
+        uint64_t pos = 0;
+        if (read(pos) != RTL_TABLE_MAGIC || read(pos + 4) != RTL_TABLE_VERSION) {
+            throw std::runtime_error("Invalid RTL table");
+        }
+        num_strings_ = read(pos + 8);
+        offsets_ = pos + 12;
+        strings_ = offsets_ + 4 * (static_cast<uint64_t>(num_strings_) + 1);
+        if (strings_ > data_.size()) throw std::runtime_error("Invalid RTL table");
+        auto strings_size = read(strings_ - 4);
+        signals_ = strings_ + strings_size + 4;
+        num_signals_ = read(signals_ - 4);
+        instances_ = signals_ + 12 * static_cast<uint64_t>(num_signals_) + 4;
+        num_instances_ = read(instances_ - 4);
+        if (instances_ + 12 * static_cast<uint64_t>(num_instances_) != data_.size()) {
+            throw std::runtime_error("Invalid RTL table");
+        }
+
+        uint32_t prev = 0;
+        for (auto i = 0u; i <= num_strings_; i++) {
+            auto offset = read(offsets_ + 4 * i);
+            if (offset < prev || (i == 0 && offset != 0)) {
+                throw std::runtime_error("Invalid RTL table");
+            }
+            prev = offset;
+        }
+        for (auto i = 0u; i < 3 * num_signals_; i++) {
+            if (i % 3 != 2 && read(signals_ + 4 * i) >= num_strings_) {
+                throw std::runtime_error("Invalid RTL table");
+            }
+        }
+        for (auto i = 0u; i < 3 * num_instances_; i++) {
+            if (read(instances_ + 4 * i) >= num_strings_) {
+                throw std::runtime_error("Invalid RTL table");
+            }
+        }
+    }
+
+    [[nodiscard]] inline uint32_t num_strings() const { return num_strings_; }
+    [[nodiscard]] inline uint32_t num_signals() const { return num_signals_; }
+    [[nodiscard]] inline uint32_t num_instances() const { return num_instances_; }
+
+    [[nodiscard]] std::string_view string(uint32_t id) const {
+        auto begin = read(offsets_ + 4 * static_cast<uint64_t>(id));
+        auto end = read(offsets_ + 4 * (static_cast<uint64_t>(id) + 1));
+        return data_.substr(strings_ + begin, end - begin);
+    }
+
+    [[nodiscard]] Signal signal(uint32_t idx) const {
+        auto pos = signals_ + 12 * static_cast<uint64_t>(idx);
+        return {string(read(pos)), string(read(pos + 4)), read(pos + 8)};
+    }
+
+    [[nodiscard]] Instance instance(uint32_t idx) const {
+        auto pos = instances_ + 12 * static_cast<uint64_t>(idx);
+        return {string(read(pos)), string(read(pos + 4)), string(read(pos + 8))};
+    }
+
+private:
+    std::string_view data_;
+    uint32_t num_strings_ = 0;
+    uint32_t num_signals_ = 0;
+    uint32_t num_instances_ = 0;
+    uint64_t offsets_ = 0;
+    uint64_t strings_ = 0;
+    uint64_t signals_ = 0;
+    uint64_t instances_ = 0;
+
+    [[nodiscard]] uint32_t read(uint64_t pos) const {
+        if (pos + 4 > data_.size()) throw std::runtime_error("Invalid RTL table");
+        uint32_t value;
+        std::memcpy(&value, data_.data() + pos, sizeof(value));
+        return value;
+    }
+};
+
+#endif  // HGDB_VITIS_RTL_TABLE_HH
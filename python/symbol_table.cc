@@ -0,0 +1,374 @@
+#include "symbol_table.hh"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <sqlite3.h>
+
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <optional>
+#include <ostream>
+
+FileStreamBuffer::FileStreamBuffer(int fd, uint64_t buffer_size) : fd_(fd), buffer_(buffer_size) {
+    setp(buffer_.data(), buffer_.data() + buffer_.size());
+}
+
+FileStreamBuffer::~FileStreamBuffer() { flush(); }
+
+FileStreamBuffer::int_type FileStreamBuffer::overflow(int_type c) {
+    if (!flush()) return traits_type::eof();
+    if (!traits_type::eq_int_type(c, traits_type::eof())) {
+        *pptr() = traits_type::to_char_type(c);
+        pbump(1);
+    }
+    return traits_type::not_eof(c);
+}
+
+int FileStreamBuffer::sync() { return flush() ? 0 : -1; }
+
+bool FileStreamBuffer::flush() {
+    const char *data = pbase();
+    auto size = pptr() - pbase();
+    while (size > 0) {
+        auto written = ::write(fd_, data, size);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data += written;
+        size -= written;
+    }
+    setp(buffer_.data(), buffer_.data() + buffer_.size());
+    return true;
+}
+
+void write_module(std::ostream &stream, Context &context, const std::string &module_name,
+                  const Scope *scope, const SerializationOptions &options) {
+    auto module = context.get_module(module_name);
+    if (!module) throw std::runtime_error("Unable to find module " + module_name);
+    stream << R"({"type":"module","name":")" << module_name << R"(","scope":[)";
+    scope->serialize(stream, options);
+    stream << R"(],"instances":[)";
+    // generate instances
+    auto const &instances = module->instances;
+    uint64_t i = 0;
+    for (auto const &[inst_name, inst] : instances) {
+        stream << R"({"name":")" << inst_name << R"(",)";
+        stream << R"("module":")" << inst->module_name << R"("})";
+        if (i != (instances.size() - 1)) {
+            stream << ",";
+        }
+        i++;
+    }
+    // no variables for now since most of them are C functions
+    stream << R"(],"variables":[]})";
+}
+
+void write_symbol_table(const std::string &filename, Context &context,
+                        const std::map<std::string, Scope *> &module_scopes,
+                        const SerializationOptions &options) {
+    auto fd = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        throw std::runtime_error("Unable to open " + filename + ": " + std::strerror(errno));
+    }
+
+    bool success;
+    try {
+        FileStreamBuffer buffer(fd);
+        std::ostream stream(&buffer);
+
+        stream << R"({"generator":"vitis","table":[)";
+        uint64_t count = 1;
+        for (auto const &[module_name, scope] : module_scopes) {
+            write_module(stream, context, module_name, scope, options);
+            if (count != module_scopes.size()) {
+                stream << ",";
+            }
+            count++;
+        }
+        stream << R"(],"top":")" << context.top_name << '"';
+        // clock attribute
+        stream << R"(,"attributes":[{"name":"clock","value":")" << context.top_name
+               << R"(.ap_clk"}]})";
+        stream.flush();
+        success = stream.good();
+    } catch (...) {
+        ::close(fd);
+        throw;
+    }
+
+    if (::close(fd) != 0 || !success) {
+        throw std::runtime_error("Unable to write symbol table to " + filename);
+    }
+}
+
+namespace {
+// same schema as hgdb's symbol table
+constexpr const char *DB_SCHEMA = R"(
+CREATE TABLE 'instance' ('id' INTEGER PRIMARY KEY NOT NULL, 'name' TEXT NOT NULL, 'annotation' TEXT);
+CREATE TABLE 'breakpoint' ('id' INTEGER PRIMARY KEY NOT NULL, 'instance_id' INTEGER,
+    'filename' TEXT NOT NULL, 'line_num' INTEGER NOT NULL, 'column_num' INTEGER NOT NULL,
+    'condition' TEXT NOT NULL, 'trigger' TEXT NOT NULL,
+    FOREIGN KEY('instance_id') REFERENCES 'instance'('id'));
+CREATE TABLE 'scope' ('scope' INTEGER PRIMARY KEY NOT NULL, 'breakpoints' TEXT NOT NULL);
+CREATE TABLE 'variable' ('id' INTEGER PRIMARY KEY NOT NULL, 'value' TEXT NOT NULL,
+    'is_rtl' INTEGER NOT NULL);
+CREATE TABLE 'context_variable' ('name' TEXT NOT NULL, 'breakpoint_id' INTEGER,
+    'variable_id' INTEGER,
+    FOREIGN KEY('breakpoint_id') REFERENCES 'breakpoint'('id'),
+    FOREIGN KEY('variable_id') REFERENCES 'variable'('id'));
+CREATE TABLE 'generator_variable' ('name' TEXT NOT NULL, 'instance_id' INTEGER,
+    'variable_id' INTEGER, 'annotation' TEXT NOT NULL,
+    FOREIGN KEY('instance_id') REFERENCES 'instance'('id'),
+    FOREIGN KEY('variable_id') REFERENCES 'variable'('id'));
+CREATE TABLE 'annotation' ('name' TEXT NOT NULL, 'value' TEXT NOT NULL);
+CREATE TABLE 'assignment' ('name' TEXT NOT NULL, 'value' TEXT NOT NULL, 'breakpoint_id' INTEGER,
+    'condition' TEXT NOT NULL, 'scope_id' INTEGER,
+    FOREIGN KEY('breakpoint_id') REFERENCES 'breakpoint'('id'));
+)";
+
+class Database {
+public:
+    explicit Database(const std::string &filename) {
+        if (sqlite3_open(filename.c_str(), &db_) != SQLITE_OK) {
+            std::string error = db_ ? sqlite3_errmsg(db_) : "out of memory";
+            sqlite3_close(db_);
+            throw std::runtime_error("Unable to open " + filename + ": " + error);
+        }
+    }
+
+    ~Database() { sqlite3_close(db_); }
+
+    void exec(const char *sql) {
+        char *error = nullptr;
+        if (sqlite3_exec(db_, sql, nullptr, nullptr, &error) != SQLITE_OK) {
+            std::string msg = error ? error : "unknown error";
+            sqlite3_free(error);
+            throw std::runtime_error("SQLite error: " + msg);
+        }
+    }
+
+    [[nodiscard]] inline sqlite3 *db() const { return db_; }
+
+private:
+    sqlite3 *db_ = nullptr;
+};
+
+class Statement {
+public:
+    Statement(const Database &db, const char *sql) : db_(db.db()) {
+        if (sqlite3_prepare_v2(db_, sql, -1, &stmt_, nullptr) != SQLITE_OK) {
+            throw std::runtime_error(std::string("SQLite error: ") + sqlite3_errmsg(db_));
+        }
+    }
+
+    ~Statement() { sqlite3_finalize(stmt_); }
+
+    void bind(int index, uint32_t value) { sqlite3_bind_int64(stmt_, index, value); }
+
+    // the value has to stay alive until insert() is called
+    void bind(int index, const std::string &value) {
+        sqlite3_bind_text(stmt_, index, value.c_str(), static_cast<int>(value.size()),
+                          SQLITE_STATIC);
+    }
+
+    void insert() {
+        if (sqlite3_step(stmt_) != SQLITE_DONE) {
+            throw std::runtime_error(std::string("SQLite error: ") + sqlite3_errmsg(db_));
+        }
+        sqlite3_reset(stmt_);
+    }
+
+private:
+    sqlite3 *db_;
+    sqlite3_stmt *stmt_ = nullptr;
+};
+
+// variable values are stored as full instance paths, the same as hgdb's own JSON conversion.
+// values are relative to the instance and may go through its parents with $parent. null if the
+// value goes above the top instance
+std::optional<std::string> resolve_rtl_value(const std::string &instance_name,
+                                             const std::string &rtl) {
+    constexpr std::string_view parent = "$parent";
+    if (rtl.find(parent) == std::string::npos) return instance_name + "." + rtl;
+
+    std::vector<std::string_view> path;
+    auto split = [&path](std::string_view value, bool allow_parent) {
+        uint64_t pos = 0;
+        while (pos <= value.size()) {
+            auto end = value.find('.', pos);
+            if (end == std::string_view::npos) end = value.size();
+            auto name = value.substr(pos, end - pos);
+            if (allow_parent && name == parent) {
+                if (path.size() <= 1) return false;
+                path.pop_back();
+            } else {
+                path.emplace_back(name);
+            }
+            pos = end + 1;
+        }
+        return true;
+    };
+    split(instance_name, false);
+    if (!split(rtl, true)) return std::nullopt;
+
+    std::string res(path[0]);
+    for (auto i = 1u; i < path.size(); i++) {
+        res.append(".").append(path[i]);
+    }
+    return res;
+}
+
+// walks every instance from the top and flattens the module scopes into hgdb's tables. ids are
+// assigned in traversal order, which is deterministic since all the containers are ordered
+class DatabaseWriter {
+public:
+    DatabaseWriter(const Database &db, const std::map<std::string, Scope *> &module_scopes,
+                   const SerializationOptions &options)
+        : module_scopes_(module_scopes),
+          options_(options),
+          insert_instance_(db, "INSERT INTO 'instance' ('id', 'name') VALUES (?, ?)"),
+          insert_breakpoint_(db,
+                             "INSERT INTO 'breakpoint' ('id', 'instance_id', 'filename', "
+                             "'line_num', 'column_num', 'condition', 'trigger') VALUES (?, ?, ?, "
+                             "?, 0, ?, '')"),
+          insert_variable_(db, "INSERT INTO 'variable' ('id', 'value', 'is_rtl') VALUES (?, ?, 1)"),
+          insert_context_variable_(db,
+                                   "INSERT INTO 'context_variable' ('name', 'breakpoint_id', "
+                                   "'variable_id') VALUES (?, ?, ?)"),
+          insert_scope_(db, "INSERT INTO 'scope' ('scope', 'breakpoints') VALUES (?, ?)") {}
+
+    // NOLINTNEXTLINE
+    void write_instance(const std::string &instance_name, const ModuleInfo &module) {
+        auto instance_id = instance_id_++;
+        insert_instance_.bind(1, instance_id);
+        insert_instance_.bind(2, instance_name);
+        insert_instance_.insert();
+
+        auto it = module_scopes_.find(module.module_name);
+        if (it != module_scopes_.end()) {
+            std::vector<std::pair<std::string, uint32_t>> variables;
+            write_scope(*it->second, instance_id, instance_name, {}, {}, variables);
+        }
+
+        for (auto const &[name, inst] : module.instances) {
+            write_instance(instance_name + "." + name, *inst);
+        }
+    }
+
+private:
+    const std::map<std::string, Scope *> &module_scopes_;
+    const SerializationOptions &options_;
+
+    Statement insert_instance_;
+    Statement insert_breakpoint_;
+    Statement insert_variable_;
+    Statement insert_context_variable_;
+    Statement insert_scope_;
+
+    uint32_t instance_id_ = 0;
+    uint32_t breakpoint_id_ = 0;
+    uint32_t variable_id_ = 0;
+    uint32_t scope_id_ = 0;
+
+    static std::string combine_condition(const std::string &parent, const std::string &cond) {
+        if (parent.empty()) return cond;
+        if (cond.empty()) return parent;
+        return "(" + parent + ")&&(" + cond + ")";
+    }
+
+    // variables declared in a block are visible to the statements that follow in the same
+    // block and to all the nested blocks
+    // NOLINTNEXTLINE
+    void write_scope(const Scope &scope, uint32_t instance_id, const std::string &instance_name,
+                     const std::string &parent_filename, const std::string &parent_condition,
+                     std::vector<std::pair<std::string, uint32_t>> &variables) {
+        auto filename = scope.filename == EMPTY_SYMBOL
+                            ? parent_filename
+                            : remap_filename(std::string(scope.context->str(scope.filename)),
+                                             options_);
+        auto condition = combine_condition(parent_condition, scope.condition());
+        auto num_variables = variables.size();
+        std::string breakpoints;
+
+        for (auto const *s : scope.scopes) {
+            if (s->kind() == ScopeKind::Block) {
+                write_scope(*s, instance_id, instance_name, filename, condition, variables);
+                continue;
+            }
+            if (auto const *decl = s->as<DeclInstruction>()) {
+                if (auto value = resolve_rtl_value(instance_name, decl->var.rtl)) {
+                    auto variable_id = variable_id_++;
+                    insert_variable_.bind(1, variable_id);
+                    insert_variable_.bind(2, *value);
+                    insert_variable_.insert();
+                    variables.emplace_back(decl->var.name, variable_id);
+                }
+            }
+            // inferred declarations don't have a location
+            if (s->line == 0) continue;
+
+            auto breakpoint_id = breakpoint_id_++;
+            auto bp_filename =
+                s->filename == EMPTY_SYMBOL
+                    ? filename
+                    : remap_filename(std::string(s->context->str(s->filename)), options_);
+            auto bp_condition = combine_condition(condition, s->condition());
+            insert_breakpoint_.bind(1, breakpoint_id);
+            insert_breakpoint_.bind(2, instance_id);
+            insert_breakpoint_.bind(3, bp_filename);
+            insert_breakpoint_.bind(4, s->line);
+            insert_breakpoint_.bind(5, bp_condition);
+            insert_breakpoint_.insert();
+
+            for (auto const &[name, variable_id] : variables) {
+                insert_context_variable_.bind(1, name);
+                insert_context_variable_.bind(2, breakpoint_id);
+                insert_context_variable_.bind(3, variable_id);
+                insert_context_variable_.insert();
+            }
+
+            if (!breakpoints.empty()) breakpoints.append(" ");
+            breakpoints.append(std::to_string(breakpoint_id));
+        }
+
+        variables.resize(num_variables);
+        if (!breakpoints.empty()) {
+            insert_scope_.bind(1, scope_id_++);
+            insert_scope_.bind(2, breakpoints);
+            insert_scope_.insert();
+        }
+    }
+};
+}  // namespace
+
+void write_symbol_table_db(const std::string &filename, Context &context,
+                           const std::map<std::string, Scope *> &module_scopes,
+                           const SerializationOptions &options) {
+    auto top = context.get_module(context.top_name);
+    if (!top) throw std::runtime_error("Unable to find top module " + context.top_name);
+
+    // always start from an empty database
+    std::error_code ec;
+    std::filesystem::remove(filename, ec);
+
+    Database db(filename);
+    // the database is recreated from scratch on failure, so there is no need for a journal
+    db.exec("PRAGMA journal_mode = OFF; PRAGMA synchronous = OFF;");
+    db.exec("BEGIN TRANSACTION;");
+    db.exec(DB_SCHEMA);
+    {
+        DatabaseWriter writer(db, module_scopes, options);
+        writer.write_instance(context.top_name, *top);
+
+        Statement insert_annotation(db, "INSERT INTO 'annotation' ('name', 'value') VALUES (?, ?)");
+        std::string name = "clock";
+        std::string value = context.top_name + ".ap_clk";
+        insert_annotation.bind(1, name);
+        insert_annotation.bind(2, value);
+        insert_annotation.insert();
+    }
+    db.exec("COMMIT;");
+}
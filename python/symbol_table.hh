@@ -0,0 +1,39 @@
+#ifndef HGDB_VITIS_SYMBOL_TABLE_HH
+#define HGDB_VITIS_SYMBOL_TABLE_HH
+
+#include <map>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+#include "ir.hh"
+
+// stream buffer that writes straight into a file descriptor. memory usage is bounded by the
+// buffer size regardless of how much is written
+class FileStreamBuffer : public std::streambuf {
+public:
+    explicit FileStreamBuffer(int fd, uint64_t buffer_size = 1 << 16);
+    ~FileStreamBuffer() override;
+
+protected:
+    int_type overflow(int_type c) override;
+    int sync() override;
+
+private:
+    int fd_;
+    std::vector<char> buffer_;
+
+    bool flush();
+};
+
+// emits the JSON symbol table module by module without building the whole table in memory
+void write_symbol_table(const std::string &filename, Context &context,
+                        const std::map<std::string, Scope *> &module_scopes,
+                        const SerializationOptions &options);
+
+// writes the hgdb SQLite schema directly, in a single transaction with prepared statements
+void write_symbol_table_db(const std::string &filename, Context &context,
+                           const std::map<std::string, Scope *> &module_scopes,
+                           const SerializationOptions &options);
+
+#endif  // HGDB_VITIS_SYMBOL_TABLE_HH
@@ -0,0 +1,171 @@
+#include "task.hh"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <iomanip>
+#include <limits>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+#include "parallel.hh"
+
+constexpr auto NO_TASK = std::numeric_limits<uint32_t>::max();
+
+void TaskGraph::add_task(const std::string &name, Task task,
+                         const std::vector<std::string> &inputs) {
+    if (ids_.find(name) != ids_.end()) throw std::runtime_error("Duplicated task " + name);
+    auto id = static_cast<uint32_t>(nodes_.size());
+    Node node;
+    node.name = name;
+    node.task = std::move(task);
+    for (auto const &input : inputs) {
+        auto it = ids_.find(input);
+        if (it == ids_.end()) {
+            throw std::runtime_error("Task " + name + " depends on unknown task " + input);
+        }
+        node.inputs.emplace_back(it->second);
+        nodes_[it->second].outputs.emplace_back(id);
+    }
+    nodes_.emplace_back(std::move(node));
+    ids_.emplace(name, id);
+}
+
+void TaskGraph::run(uint32_t num_threads) {
+    if (nodes_.empty()) return;
+    num_threads = resolve_num_threads(num_threads, nodes_.size());
+
+    std::mutex mutex;
+    std::condition_variable cond;
+    // lowest id first, so a single thread runs the tasks in the order they were added
+    std::set<uint32_t> ready;
+    std::vector<uint32_t> num_pending(nodes_.size());
+    std::vector<std::exception_ptr> errors(nodes_.size());
+    std::vector<bool> skipped(nodes_.size(), false);
+    uint64_t num_done = 0;
+    for (auto i = 0u; i < nodes_.size(); i++) {
+        num_pending[i] = static_cast<uint32_t>(nodes_[i].inputs.size());
+        nodes_[i].start = nodes_[i].end = 0;
+        if (num_pending[i] == 0) ready.emplace(i);
+    }
+
+    auto begin = std::chrono::steady_clock::now();
+    auto seconds = [begin]() {
+        std::chrono::duration<double> d = std::chrono::steady_clock::now() - begin;
+        return d.count();
+    };
+
+    auto worker = [&]() {
+        std::unique_lock lock(mutex);
+        while (true) {
+            cond.wait(lock, [&]() { return !ready.empty() || num_done == nodes_.size(); });
+            if (ready.empty()) break;
+            auto id = *ready.begin();
+            ready.erase(ready.begin());
+            auto &node = nodes_[id];
+
+            if (!skipped[id]) {
+                lock.unlock();
+                node.start = seconds();
+                try {
+                    node.task();
+                } catch (...) {
+                    errors[id] = std::current_exception();
+                }
+                node.end = seconds();
+                lock.lock();
+            }
+
+            num_done++;
+            for (auto output : node.outputs) {
+                if (errors[id] || skipped[id]) skipped[output] = true;
+                if (--num_pending[output] == 0) ready.emplace(output);
+            }
+            cond.notify_all();
+        }
+    };
+
+    std::vector<std::thread> threads;
+    threads.reserve(num_threads - 1);
+    for (auto i = 1u; i < num_threads; i++) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (auto &t : threads) t.join();
+    total_time_ = seconds();
+
+    for (auto const &error : errors) {
+        if (error) std::rethrow_exception(error);
+    }
+}
+
+std::vector<TaskGraph::Timing> TaskGraph::timings() const {
+    std::vector<Timing> res;
+    res.reserve(nodes_.size());
+    for (auto const &node : nodes_) {
+        res.emplace_back(Timing{node.name, node.start, node.end});
+    }
+    return res;
+}
+
+std::vector<std::pair<double, uint32_t>> TaskGraph::longest_paths() const {
+    // nodes are already in topological order since inputs are added first
+    std::vector<std::pair<double, uint32_t>> paths(nodes_.size(), {0, NO_TASK});
+    for (auto i = 0u; i < nodes_.size(); i++) {
+        auto const &node = nodes_[i];
+        for (auto input : node.inputs) {
+            if (paths[input].first > paths[i].first) paths[i] = {paths[input].first, input};
+        }
+        paths[i].first += node.end - node.start;
+    }
+    return paths;
+}
+
+std::vector<std::string> TaskGraph::critical_path() const {
+    auto paths = longest_paths();
+    if (paths.empty()) return {};
+    auto longest = std::max_element(paths.begin(), paths.end(), [](auto const &a, auto const &b) {
+        return a.first < b.first;
+    });
+    auto last = static_cast<uint32_t>(std::distance(paths.begin(), longest));
+    std::vector<std::string> res;
+    for (auto id = last; id != NO_TASK; id = paths[id].second) {
+        res.emplace_back(nodes_[id].name);
+    }
+    std::reverse(res.begin(), res.end());
+    return res;
+}
+
+double TaskGraph::critical_path_time() const {
+    double res = 0;
+    for (auto const &[time, prev] : longest_paths()) {
+        res = std::max(res, time);
+    }
+    return res;
+}
+
+std::string TaskGraph::report() const {
+    std::stringstream ss;
+    ss << std::fixed << std::setprecision(3);
+    uint64_t width = 4;
+    for (auto const &node : nodes_) width = std::max<uint64_t>(width, node.name.size());
+    ss << std::left << std::setw(static_cast<int>(width)) << "task"
+       << "     start       end  duration" << std::endl;
+    for (auto const &node : nodes_) {
+        ss << std::left << std::setw(static_cast<int>(width)) << node.name << std::right
+           << std::setw(10) << node.start << std::setw(10) << node.end << std::setw(10)
+           << node.end - node.start << std::endl;
+    }
+    ss << "critical path: ";
+    auto path = critical_path();
+    for (auto i = 0u; i < path.size(); i++) {
+        if (i > 0) ss << " -> ";
+        ss << path[i];
+    }
+    ss << " (" << critical_path_time() << "s of " << total_time_ << "s total)";
+    return ss.str();
+}
@@ -0,0 +1,55 @@
+#ifndef HGDB_VITIS_TASK_HH
+#define HGDB_VITIS_TASK_HH
+
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// runs named tasks on a thread pool as soon as all of their inputs are done. every task is timed
+// so that the critical path of a run can be reported
+class TaskGraph {
+public:
+    using Task = std::function<void()>;
+
+    struct Timing {
+        std::string name;
+        // seconds since the start of the run
+        double start;
+        double end;
+    };
+
+    // inputs have to be added first, which also rules out cycles
+    void add_task(const std::string &name, Task task, const std::vector<std::string> &inputs = {});
+
+    // num_threads = 0 uses all hardware threads. tasks that depend on a failed one are skipped
+    // and the first error, in the order tasks were added, is rethrown
+    void run(uint32_t num_threads = 0);
+
+    [[nodiscard]] std::vector<Timing> timings() const;
+    // longest chain of dependent tasks, weighted by how long each task took
+    [[nodiscard]] std::vector<std::string> critical_path() const;
+    [[nodiscard]] double critical_path_time() const;
+    [[nodiscard]] inline double total_time() const { return total_time_; }
+
+    [[nodiscard]] std::string report() const;
+
+private:
+    struct Node {
+        std::string name;
+        Task task;
+        std::vector<uint32_t> inputs;
+        std::vector<uint32_t> outputs;
+        double start = 0;
+        double end = 0;
+    };
+    std::vector<Node> nodes_;
+    std::unordered_map<std::string, uint32_t> ids_;
+    double total_time_ = 0;
+
+    // node id -> (path time, previous node on the path)
+    [[nodiscard]] std::vector<std::pair<double, uint32_t>> longest_paths() const;
+};
+
+#endif  // HGDB_VITIS_TASK_HH
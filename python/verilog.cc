@@ -1,9 +1,18 @@
 
 
+#include <algorithm>
+#include <fstream>
 #include <iostream>
+#include <mutex>
+#include <optional>
+#include <unordered_set>
 
+#include "cache.hh"
+#include "future.hh"
+#include "parallel.hh"
 #include "pybind11/pybind11.h"
 #include "pybind11/stl.h"
+#include "rtl_table.hh"
 #include "slang/compilation/Compilation.h"
 #include "slang/diagnostics/DiagnosticEngine.h"
 #include "slang/parsing/Parser.h"
@@ -16,26 +25,110 @@
 
 namespace py = pybind11;
 
-struct RTLInfo {
-    std::unordered_map<std::string, std::unordered_map<std::string, uint32_t>> signals;
-    std::unordered_map<std::string, std::unordered_map<std::string, std::string>> instances;
+// the table is handed to the vitis module as is, see rtl_table.hh. lookups go through a per
+// module index so Python never has to convert the whole table
+class RTLInfo {
+public:
+    using SignalMap = std::unordered_map<std::string, uint32_t>;
+    using InstanceMap = std::unordered_map<std::string, std::string>;
+
+    // throws std::runtime_error if the table is malformed
+    explicit RTLInfo(std::string table) : table_(std::move(table)), view_(table_) {
+        for (auto i = 0u; i < view_.num_signals(); i++) {
+            auto signal = view_.signal(i);
+            signal_ids_[signal.module].emplace(signal.name, i);
+        }
+        for (auto i = 0u; i < view_.num_instances(); i++) {
+            instance_ids_[view_.instance(i).parent].emplace_back(i);
+        }
+    }
+    RTLInfo(const RTLInfo &) = delete;
+    RTLInfo &operator=(const RTLInfo &) = delete;
+
+    [[nodiscard]] inline const std::string &table() const { return table_; }
+
+    // every module with either signals or instances, in ascending order
+    [[nodiscard]] std::vector<std::string> modules() const {
+        std::vector<std::string> res;
+        for (auto const &[module_name, ids] : signal_ids_) res.emplace_back(module_name);
+        for (auto const &[module_name, ids] : instance_ids_) {
+            if (!has_module_signals(module_name)) res.emplace_back(module_name);
+        }
+        std::sort(res.begin(), res.end());
+        return res;
+    }
+
+    [[nodiscard]] inline bool has_module(std::string_view module_name) const {
+        return has_module_signals(module_name) ||
+               instance_ids_.find(module_name) != instance_ids_.end();
+    }
+
+    [[nodiscard]] std::optional<SignalMap> get_signals(std::string_view module_name) const {
+        auto it = signal_ids_.find(module_name);
+        if (it == signal_ids_.end()) return std::nullopt;
+        SignalMap res;
+        for (auto const &[name, id] : it->second) {
+            res.emplace(name, view_.signal(id).width);
+        }
+        return res;
+    }
+
+    [[nodiscard]] std::optional<InstanceMap> get_instances(std::string_view module_name) const {
+        auto it = instance_ids_.find(module_name);
+        if (it == instance_ids_.end()) return std::nullopt;
+        InstanceMap res;
+        for (auto id : it->second) {
+            auto inst = view_.instance(id);
+            res.emplace(inst.name, inst.definition);
+        }
+        return res;
+    }
+
+    [[nodiscard]] bool has_signal(std::string_view module_name, std::string_view name) const {
+        auto it = signal_ids_.find(module_name);
+        return it != signal_ids_.end() && it->second.find(name) != it->second.end();
+    }
+
+    // whole table as nested maps. slow, prefer the per module lookups above
+    [[nodiscard]] std::unordered_map<std::string, SignalMap> signals() const {
+        std::unordered_map<std::string, SignalMap> res;
+        for (auto const &[module_name, ids] : signal_ids_) {
+            res.emplace(module_name, *get_signals(module_name));
+        }
+        return res;
+    }
+
+    [[nodiscard]] std::unordered_map<std::string, InstanceMap> instances() const {
+        std::unordered_map<std::string, InstanceMap> res;
+        for (auto const &[module_name, ids] : instance_ids_) {
+            res.emplace(module_name, *get_instances(module_name));
+        }
+        return res;
+    }
+
+private:
+    std::string table_;
+    RTLTableView view_;
+    // module -> signal name -> record id. names are unique per module, see RTLTableWriter
+    std::unordered_map<std::string_view, std::unordered_map<std::string_view, uint32_t>>
+        signal_ids_;
+    // module -> record ids in table order
+    std::unordered_map<std::string_view, std::vector<uint32_t>> instance_ids_;
+
+    [[nodiscard]] inline bool has_module_signals(std::string_view module_name) const {
+        return signal_ids_.find(module_name) != signal_ids_.end();
+    }
 };
 
 class VisitSignals : public slang::ASTVisitor<VisitSignals, true, true> {
 public:
-    VisitSignals(
-        std::unordered_map<std::string, std::unordered_map<std::string, uint32_t>> &signals,
-        std::unordered_map<std::string, std::unordered_map<std::string, std::string>> &instances,
-        const slang::InstanceSymbol *inst)
-        : current_module_name(std::string(inst->getDefinition().name)),
-          signals_(signals),
-          instances_(instances){}
+    VisitSignals(RTLTableWriter &table, const slang::InstanceSymbol *inst)
+        : current_module_name(inst->getDefinition().name), table_(table) {}
 
     [[maybe_unused]] void handle(const slang::InstanceSymbol &sym) {
-        auto def_name = std::string(sym.getDefinition().name);
-        if (instances_.find(def_name) != instances_.end()) return;
-        auto inst_name = std::string(sym.name);
-        instances_[current_module_name].emplace(inst_name, def_name);
+        auto def_name = sym.getDefinition().name;
+        if (table_.has_instances(def_name)) return;
+        table_.add_instance(current_module_name, sym.name, def_name);
 
         auto temp = current_module_name;
         current_module_name = def_name;
@@ -44,24 +137,21 @@ public:
     }
 
     [[maybe_unused]] void handle(const slang::NetSymbol &sym) {
-        auto name = std::string(sym.name);
         uint32_t width = sym.getType().getBitWidth();
-        signals_[current_module_name].emplace(name, width);
+        table_.add_signal(current_module_name, sym.name, width);
 
         // check if the net is used for direct connection between two instances
     }
 
     [[maybe_unused]] void handle(const slang::VariableSymbol &sym) {
-        auto name = std::string(sym.name);
         uint32_t width = sym.getType().getBitWidth();
-        signals_[current_module_name].emplace(name, width);
+        table_.add_signal(current_module_name, sym.name, width);
     }
 
-    std::string current_module_name;
+    std::string_view current_module_name;
 
 private:
-    std::unordered_map<std::string, std::unordered_map<std::string, uint32_t>> &signals_;
-    std::unordered_map<std::string, std::unordered_map<std::string, std::string>> &instances_;
+    RTLTableWriter &table_;
 
     class SymbolCollector : public slang::ASTVisitor<SymbolCollector, true, true> {
     public:
@@ -101,8 +191,154 @@ private:
     };
 };
 
-std::unique_ptr<RTLInfo> parse_verilog(const std::vector<std::string> &files,
-                                       const std::string &top_name) {
+// module name -> every identifier used in its body
+using ModuleReferences = std::vector<std::pair<std::string, std::unordered_set<std::string>>>;
+
+// cheap tokenizer that only understands comments, strings, identifiers and directives. any
+// identifier in a module body counts as a reference, which over-approximates the instantiated
+// modules but never misses one. nested modules are scanned as modules of their own
+ModuleReferences scan_verilog_modules(std::string_view content) {
+    ModuleReferences res;
+    auto is_ident_start = [](char c) {
+        return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+    };
+    auto is_ident = [&](char c) { return is_ident_start(c) || (c >= '0' && c <= '9') || c == '$'; };
+    auto is_space = [](char c) {
+        return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f' || c == '\v';
+    };
+
+    // indices into res of the modules the scanner is in, innermost last
+    std::vector<uint64_t> open_modules;
+    bool expect_name = false;
+    uint64_t pos = 0;
+    while (pos < content.size()) {
+        auto c = content[pos];
+        if (c == '/' && pos + 1 < content.size() && content[pos + 1] == '/') {
+            auto end = content.find('\n', pos);
+            pos = end == std::string_view::npos ? content.size() : end;
+            continue;
+        }
+        if (c == '/' && pos + 1 < content.size() && content[pos + 1] == '*') {
+            auto end = content.find("*/", pos + 2);
+            pos = end == std::string_view::npos ? content.size() : end + 2;
+            continue;
+        }
+        if (c == '"') {
+            pos++;
+            while (pos < content.size() && content[pos] != '"' && content[pos] != '\n') {
+                pos += content[pos] == '\\' ? 2 : 1;
+            }
+            pos++;
+            continue;
+        }
+        if (c == '`') {
+            // compiler directive or macro usage, neither is a module name
+            pos++;
+            while (pos < content.size() && is_ident(content[pos])) pos++;
+            continue;
+        }
+
+        std::string_view ident;
+        bool escaped = false;
+        if (is_ident_start(c)) {
+            auto start = pos;
+            while (pos < content.size() && is_ident(content[pos])) pos++;
+            ident = content.substr(start, pos - start);
+        } else if (c == '\\') {
+            // escaped identifier, ends at the first white space
+            auto start = ++pos;
+            while (pos < content.size() && !is_space(content[pos])) pos++;
+            ident = content.substr(start, pos - start);
+            escaped = true;
+        } else if (c >= '0' && c <= '9') {
+            // also skips the digits of based numbers such as 8'hff
+            while (pos < content.size() && is_ident(content[pos])) pos++;
+            continue;
+        } else if (c == '\'') {
+            // base of a number, e.g. 'h1f
+            pos++;
+            if (pos < content.size() && (content[pos] == 's' || content[pos] == 'S')) pos++;
+            while (pos < content.size() && is_ident(content[pos])) pos++;
+            continue;
+        } else {
+            pos++;
+            continue;
+        }
+
+        if (expect_name) {
+            // module automatic foo
+            if (!escaped && (ident == "automatic" || ident == "static")) continue;
+            open_modules.emplace_back(res.size());
+            res.emplace_back(std::string(ident), std::unordered_set<std::string>{});
+            expect_name = false;
+        } else if (escaped) {
+            if (!open_modules.empty()) res[open_modules.back()].second.emplace(ident);
+        } else if (ident == "module" || ident == "macromodule") {
+            expect_name = true;
+        } else if (ident == "endmodule") {
+            if (!open_modules.empty()) open_modules.pop_back();
+        } else if (!open_modules.empty()) {
+            res[open_modules.back()].second.emplace(ident);
+        }
+    }
+    return res;
+}
+
+// files that define the top or any module it may instantiate, in their original order. files
+// without modules are kept since they may hold packages or interfaces. falls back to every file
+// if the top is not found, so slang can report the actual problem
+std::vector<std::string> prune_verilog_files(const std::vector<std::string> &files,
+                                             const std::string &top_name, uint32_t num_threads) {
+    std::vector<ModuleReferences> modules(files.size());
+    parallel_for(files.size(), num_threads, [&](uint64_t idx) {
+        std::ifstream stream(files[idx], std::ios::binary);
+        if (!stream) return;
+        std::string content((std::istreambuf_iterator<char>(stream)),
+                            std::istreambuf_iterator<char>());
+        modules[idx] = scan_verilog_modules(content);
+    });
+
+    // module name -> files that define it
+    std::unordered_map<std::string_view, std::vector<uint64_t>> definitions;
+    for (auto i = 0u; i < files.size(); i++) {
+        for (auto const &[name, refs] : modules[i]) definitions[name].emplace_back(i);
+    }
+    if (definitions.find(top_name) == definitions.end()) return files;
+
+    std::vector<bool> keep(files.size(), false);
+    std::unordered_set<std::string_view> visited = {top_name};
+    std::vector<std::string_view> stack = {top_name};
+    while (!stack.empty()) {
+        auto name = stack.back();
+        stack.pop_back();
+        for (auto idx : definitions.at(name)) {
+            keep[idx] = true;
+            for (auto const &[module_name, refs] : modules[idx]) {
+                if (module_name != name) continue;
+                for (auto const &ref : refs) {
+                    if (definitions.find(ref) != definitions.end() &&
+                        visited.emplace(ref).second) {
+                        stack.emplace_back(ref);
+                    }
+                }
+            }
+        }
+    }
+
+    std::vector<std::string> res;
+    for (auto i = 0u; i < files.size(); i++) {
+        if (keep[i] || modules[i].empty()) res.emplace_back(files[i]);
+    }
+    return res;
+}
+
+std::shared_ptr<RTLInfo> parse_verilog(const std::vector<std::string> &input_files,
+                                       const std::string &top_name, uint32_t num_threads,
+                                       bool prune) {
+    // stale modules and unused IP wrappers never reach slang
+    auto files = prune ? prune_verilog_files(input_files, top_name, num_threads) : input_files;
+
+    // a compilation needs all of its trees to come from the same source manager
     slang::SourceManager source_manager;
 
     slang::PreprocessorOptions preprocessor_options;
@@ -117,19 +353,36 @@ std::unique_ptr<RTLInfo> parse_verilog(const std::vector<std::string> &files,
     options.set(parser_options);
     options.set(compilation_options);
 
-    std::vector<slang::SourceBuffer> buffers;
-    for (const std::string &file : files) {
-        slang::SourceBuffer buffer = source_manager.readSource(file);
-        if (!buffer) {
-            std::cerr << file << " does not exist" << std::endl;
+    // every worker reads its own file. the tree does not pin a slang revision that documents the
+    // source manager as thread-safe, so registering the text and parsing it, which both go
+    // through the shared source manager, are serialized
+    std::vector<std::shared_ptr<slang::SyntaxTree>> trees(files.size());
+    // not vector<bool>, workers write to neighboring entries
+    std::vector<uint8_t> missing(files.size(), 0);
+    std::mutex source_mutex;
+    parallel_for(files.size(), num_threads, [&](uint64_t idx) {
+        std::ifstream stream(files[idx], std::ios::binary);
+        std::string content;
+        if (stream) {
+            content.assign(std::istreambuf_iterator<char>(stream),
+                           std::istreambuf_iterator<char>());
+        } else {
+            missing[idx] = 1;
         }
 
-        buffers.push_back(buffer);
+        std::lock_guard guard(source_mutex);
+        auto buffer = missing[idx] ? source_manager.readSource(files[idx])
+                                   : source_manager.assignText(files[idx], content);
+        trees[idx] = slang::SyntaxTree::fromBuffer(buffer, source_manager, options);
+    });
+
+    for (auto i = 0u; i < files.size(); i++) {
+        if (missing[i]) std::cerr << files[i] << " does not exist" << std::endl;
     }
 
+    // same order as the files, so the result doesn't depend on scheduling
     slang::Compilation compilation;
-    for (const slang::SourceBuffer &buffer : buffers)
-        compilation.addSyntaxTree(slang::SyntaxTree::fromBuffer(buffer, source_manager, options));
+    for (auto &tree : trees) compilation.addSyntaxTree(std::move(tree));
 
     auto const &top_instances = compilation.getRoot().topInstances;
     const slang::InstanceSymbol *top = nullptr;
@@ -144,16 +397,79 @@ std::unique_ptr<RTLInfo> parse_verilog(const std::vector<std::string> &files,
         throw std::runtime_error("Unable to find top instance " + top_name);
     }
 
-    auto res = std::make_unique<RTLInfo>();
-    VisitSignals vis(res->signals, res->instances, top);
+    RTLTableWriter table;
+    VisitSignals vis(table, top);
     top->visit(vis);
 
-    return res;
+    return std::make_shared<RTLInfo>(table.data());
+}
+
+std::shared_ptr<RTLInfo> parse_verilog(const std::vector<std::string> &files,
+                                       const std::string &top_name, const std::string &cache_dir,
+                                       uint32_t num_threads, bool prune) {
+    InputCache cache(cache_dir, "rtl");
+    std::string key;
+    if (cache.enabled()) {
+        auto salt = top_name + (prune ? ":prune" : "");
+        key = cache.compute_key(files, salt);
+        if (auto data = cache.load(key)) {
+            try {
+                return std::make_shared<RTLInfo>(std::move(*data));
+            } catch (const std::runtime_error &) {
+                // stale or corrupted entry, parse again
+            }
+        }
+    }
+
+    auto info = parse_verilog(files, top_name, num_threads, prune);
+    if (cache.enabled()) {
+        cache.store(key, info->table());
+    }
+    return info;
 }
 
 PYBIND11_MODULE(vitis_rtl, m) {
-    py::class_<RTLInfo>(m, "RTLInfo")
-        .def_readonly("signals", &RTLInfo::signals)
-        .def_readonly("instances", &RTLInfo::instances);
-    m.def("parse_verilog", &parse_verilog);
+    // shared so that a finished future and Python can both hold on to the result
+    py::class_<RTLInfo, std::shared_ptr<RTLInfo>>(m, "RTLInfo")
+        // zero-copy view of the table, to be passed to Context.set_rtl_table
+        .def_property_readonly(
+            "table",
+            [](const RTLInfo &info) {
+                return py::memoryview::from_memory(info.table().data(),
+                                                   static_cast<py::ssize_t>(info.table().size()));
+            },
+            py::keep_alive<0, 1>())
+        .def("modules", &RTLInfo::modules)
+        .def("__contains__", &RTLInfo::has_module)
+        // None if the module has no signals/instances
+        .def("get_signals", &RTLInfo::get_signals, py::arg("module_name"))
+        .def("get_instances", &RTLInfo::get_instances, py::arg("module_name"))
+        .def("has_signal", &RTLInfo::has_signal, py::arg("module_name"), py::arg("name"))
+        // slow, since every entry of the table is converted to Python objects
+        .def_property_readonly("signals", &RTLInfo::signals)
+        .def_property_readonly("instances", &RTLInfo::instances);
+    bind_future<std::shared_ptr<RTLInfo>>(m, "RTLInfoFuture");
+
+    // what parse_verilog hands to slang when prune is set
+    m.def("prune_verilog_files", &prune_verilog_files, py::arg("files"), py::arg("top_name"),
+          py::arg("num_threads") = 0, py::call_guard<py::gil_scoped_release>());
+
+    using ParseVerilog =
+        std::shared_ptr<RTLInfo> (*)(const std::vector<std::string> &, const std::string &,
+                                     const std::string &, uint32_t, bool);
+    // files are parsed on num_threads workers, 0 uses all hardware threads.
+    // prune only hands files that may be instantiated under the top to slang
+    m.def("parse_verilog", static_cast<ParseVerilog>(&parse_verilog), py::arg("files"),
+          py::arg("top_name"), py::arg("cache_dir") = "", py::arg("num_threads") = 0,
+          py::arg("prune") = true,
+          py::call_guard<py::gil_scoped_release>());
+    m.def(
+        "parse_verilog_async",
+        [](const std::vector<std::string> &files, const std::string &top_name,
+           const std::string &cache_dir, uint32_t num_threads, bool prune) {
+            return launch_async(static_cast<ParseVerilog>(&parse_verilog), files, top_name,
+                                cache_dir, num_threads, prune);
+        },
+        py::arg("files"), py::arg("top_name"), py::arg("cache_dir") = "",
+        py::arg("num_threads") = 0, py::arg("prune") = true);
 }
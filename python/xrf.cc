@@ -0,0 +1,185 @@
+#include "xrf.hh"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <filesystem>
+#include <optional>
+#include <stdexcept>
+#include <string_view>
+#include <unordered_set>
+
+#include "parallel.hh"
+
+// read-only view of a whole file. the kernel pages it in on demand, so nothing is copied
+class MappedFile {
+public:
+    explicit MappedFile(const std::string &filename) {
+        fd_ = ::open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd_ < 0) throw std::runtime_error("Unable to find file " + filename);
+        struct stat st {};
+        if (::fstat(fd_, &st) != 0) {
+            ::close(fd_);
+            throw std::runtime_error("Unable to read file " + filename);
+        }
+        size_ = static_cast<uint64_t>(st.st_size);
+        if (size_ == 0) return;
+        auto *data = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd_, 0);
+        if (data == MAP_FAILED) {
+            ::close(fd_);
+            throw std::runtime_error("Unable to read file " + filename);
+        }
+        ::madvise(data, size_, MADV_SEQUENTIAL);
+        data_ = static_cast<const char *>(data);
+    }
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    ~MappedFile() {
+        if (data_) ::munmap(const_cast<char *>(data_), size_);
+        ::close(fd_);
+    }
+
+    [[nodiscard]] inline std::string_view content() const { return {data_, size_}; }
+
+private:
+    int fd_ = -1;
+    const char *data_ = nullptr;
+    uint64_t size_ = 0;
+};
+
+constexpr std::string_view STATE_HEADER = "RTL state condition: (1'b1 == ";
+
+inline bool is_word(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+}
+
+inline bool is_digit(char c) { return c >= '0' && c <= '9'; }
+
+inline bool is_space(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f' || c == '\v';
+}
+
+// same as searching for RTL state condition: \(1'b1 == ([\w_\d]+)\)
+std::optional<std::string_view> match_state_header(std::string_view line) {
+    uint64_t pos = 0;
+    while (pos < line.size()) {
+        auto const *found = static_cast<const char *>(::memmem(
+            line.data() + pos, line.size() - pos, STATE_HEADER.data(), STATE_HEADER.size()));
+        if (!found) break;
+        auto start = static_cast<uint64_t>(found - line.data()) + STATE_HEADER.size();
+        auto end = start;
+        while (end < line.size() && is_word(line[end])) end++;
+        if (end > start && end < line.size() && line[end] == ')') {
+            return line.substr(start, end - start);
+        }
+        pos = start - STATE_HEADER.size() + 1;
+    }
+    return std::nullopt;
+}
+
+// matches the location part of rest, i.e. (.*):(\d+)>. since .* is greedy, the last
+// :<digits>> decides where the file name ends
+bool match_location(std::string_view rest, std::string_view &filename, uint32_t &line_num) {
+    for (auto end = rest.rfind('>'); end != std::string_view::npos && end > 0;
+         end = rest.rfind('>', end - 1)) {
+        auto digits = end;
+        while (digits > 0 && is_digit(rest[digits - 1])) digits--;
+        if (digits == end || digits == 0 || rest[digits - 1] != ':') continue;
+        uint64_t value = 0;
+        for (auto i = digits; i < end; i++) {
+            value = value * 10 + static_cast<uint64_t>(rest[i] - '0');
+        }
+        filename = rest.substr(0, digits - 1);
+        line_num = static_cast<uint32_t>(value);
+        return true;
+    }
+    return false;
+}
+
+// same as searching for '\s<(.*):(\d+)>. every '\s< is tried in order, the first one that is
+// followed by a location decides where the file name starts
+bool match_state_location(std::string_view line, std::string_view &filename, uint32_t &line_num) {
+    uint64_t pos = 0;
+    while (pos < line.size()) {
+        auto const *quote =
+            static_cast<const char *>(std::memchr(line.data() + pos, '\'', line.size() - pos));
+        if (!quote) return false;
+        auto idx = static_cast<uint64_t>(quote - line.data());
+        pos = idx + 1;
+        if (idx + 2 < line.size() && is_space(line[idx + 1]) && line[idx + 2] == '<' &&
+            match_location(line.substr(idx + 3), filename, line_num)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+std::map<std::string, StateInfo> parse_xrf(const std::string &filename) {
+    MappedFile file(filename);
+    auto content = file.content();
+
+    std::map<std::string, StateInfo> res;
+    StateInfo *current_state = nullptr;
+    uint64_t pos = 0;
+    while (pos < content.size()) {
+        // lines end with \n, \r\n or \r, same as Python's universal newlines
+        auto const *start = content.data() + pos;
+        auto remaining = content.size() - pos;
+        auto const *end = static_cast<const char *>(std::memchr(start, '\n', remaining));
+        auto size = end ? static_cast<uint64_t>(end - start) : remaining;
+        auto const *cr = static_cast<const char *>(std::memchr(start, '\r', size));
+        if (cr) size = static_cast<uint64_t>(cr - start);
+        std::string_view line(start, size);
+        pos += size + 1;
+        if (cr && pos < content.size() && content[pos] == '\n') pos++;
+
+        if (auto state_name = match_state_header(line)) {
+            std::string name(*state_name);
+            auto [it, inserted] = res.insert_or_assign(name, StateInfo(name));
+            current_state = &it->second;
+            continue;
+        }
+
+        std::string_view loc_filename;
+        uint32_t line_num;
+        if (current_state && match_state_location(line, loc_filename, line_num)) {
+            current_state->add_instruction(std::string(loc_filename), line_num);
+        }
+    }
+
+    return res;
+}
+
+void parse_state_transitions(Context &context, const std::string &directory,
+                             uint32_t num_threads) {
+    auto top = context.get_module(context.top_name);
+    if (!top) throw std::runtime_error("Unable to find top module " + context.top_name);
+
+    // every module reachable from top, once
+    std::vector<ModuleInfo *> modules;
+    std::unordered_set<ModuleInfo *> visited;
+    std::vector<ModuleInfo *> stack = {top.get()};
+    while (!stack.empty()) {
+        auto *module = stack.back();
+        stack.pop_back();
+        if (!visited.emplace(module).second) continue;
+        modules.emplace_back(module);
+        for (auto const &[inst_name, inst] : module->instances) {
+            stack.emplace_back(inst.get());
+        }
+    }
+
+    std::vector<std::map<std::string, StateInfo>> results(modules.size());
+    parallel_for(modules.size(), num_threads, [&](uint64_t idx) {
+        auto filename = std::filesystem::path(directory) / (modules[idx]->module_name + ".xrf");
+        results[idx] = parse_xrf(filename.string());
+    });
+
+    for (auto i = 0u; i < modules.size(); i++) {
+        modules[i]->state_infos = std::move(results[i]);
+    }
+}
@@ -0,0 +1,20 @@
+#ifndef HGDB_VITIS_XRF_HH
+#define HGDB_VITIS_XRF_HH
+
+#include <map>
+#include <string>
+
+#include "ir.hh"
+
+// state name -> locations of the instructions executed in that state. the file is a list of
+// "RTL state condition: (1'b1 == <state>)" headers, each followed by source locations in the
+// form of '<file>:<line>'
+std::map<std::string, StateInfo> parse_xrf(const std::string &filename);
+
+// reads <directory>/<module>.xrf for the top module and every module instantiated below it, and
+// fills in their state infos. every module is parsed once, even if instantiated several times.
+// files are spread over num_threads workers (0 uses all hardware threads)
+void parse_state_transitions(Context &context, const std::string &directory,
+                             uint32_t num_threads = 0);
+
+#endif  // HGDB_VITIS_XRF_HH
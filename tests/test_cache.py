@@ -0,0 +1,26 @@
+import subprocess
+import os
+import tempfile
+
+
+def test_cache():
+    with tempfile.TemporaryDirectory() as temp:
+        root_dir = os.path.dirname(os.path.abspath(__file__))
+        vector_files = os.path.join(root_dir, "vectors", "dct")
+        cache_dir = os.path.join(temp, "cache")
+        outputs = []
+        # first run populates the cache, second run loads from it
+        for i in range(2):
+            output = os.path.join(temp, "debug{0}.json".format(i))
+            subprocess.check_call(["hgdb-vitis", vector_files, "-o", output, "--cache-dir", cache_dir])
+            with open(output) as f:
+                outputs.append(f.read())
+        assert outputs[0] == outputs[1]
+        entries = sorted(os.listdir(cache_dir))
+        assert len(entries) == 2
+        assert entries[0].startswith("debug-bc-")
+        assert entries[1].startswith("rtl-")
+
+
+if __name__ == "__main__":
+    test_cache()
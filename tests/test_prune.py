@@ -0,0 +1,57 @@
+import os
+import tempfile
+
+import vitis_rtl
+
+
+def write_files(directory, contents):
+    files = []
+    for name, content in contents:
+        filename = os.path.join(directory, name)
+        with open(filename, "w") as f:
+            f.write(content)
+        files.append(filename)
+    return files
+
+
+def test_prune():
+    with tempfile.TemporaryDirectory() as temp:
+        files = write_files(temp, [
+            ("top.v", """
+// unused_a u0();
+/* unused_b u1(); */
+module automatic top (input clk);
+    wire [7:0] msg = "unused_c u2();";
+    mid mid_i (.clk(clk));
+    \\esc$mod esc_i ();
+endmodule
+"""),
+            # several modules per file, the file is kept if any of them is needed
+            ("mid.v", """
+module mid (input clk);
+    leaf leaf_i ();
+endmodule
+module other;
+    unused_d u3 ();
+endmodule
+"""),
+            ("leaf.v", "module static leaf; endmodule\n"),
+            ("esc.v", "module \\esc$mod ; endmodule\n"),
+            ("unused_a.v", "module unused_a; endmodule\n"),
+            ("unused_b.v", "module unused_b; endmodule\n"),
+            ("unused_c.v", "module unused_c; endmodule\n"),
+            ("unused_d.v", "module unused_d; endmodule\n"),
+            # files without modules may hold packages
+            ("pkg.sv", "package pkg; endpackage\n"),
+        ])
+        pruned = vitis_rtl.prune_verilog_files(files, "top")
+        names = [os.path.basename(f) for f in pruned]
+        # original order is kept. mid.v also defines other, whose instances are not followed
+        assert names == ["top.v", "mid.v", "leaf.v", "esc.v", "pkg.sv"]
+
+        # slang reports a missing top, so every file is handed over
+        assert vitis_rtl.prune_verilog_files(files, "missing") == files
+
+
+if __name__ == "__main__":
+    test_prune()
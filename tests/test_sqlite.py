@@ -0,0 +1,52 @@
+import subprocess
+import os
+import sqlite3
+import tempfile
+
+
+def test_dct_sqlite():
+    with tempfile.TemporaryDirectory() as temp:
+        root_dir = os.path.dirname(os.path.abspath(__file__))
+        vector_files = os.path.join(root_dir, "vectors", "dct")
+        output_db = os.path.join(temp, "debug.db")
+        subprocess.check_call(["hgdb-vitis", vector_files, "-o", output_db, "--format", "sqlite", "-r",
+                               "/home/keyi/AHA/Vitis-Tutorials/Getting_Started/Vitis_HLS/reference-files/src/:" +
+                               temp])
+
+        conn = sqlite3.connect(output_db)
+        instances = [name for name, in conn.execute("SELECT name FROM instance")]
+        assert "dct" in instances
+        num_breakpoints, = conn.execute("SELECT COUNT(*) FROM breakpoint").fetchone()
+        assert num_breakpoints > 0
+        filenames = {f for f, in conn.execute("SELECT DISTINCT filename FROM breakpoint")}
+        assert any(f.startswith(temp) for f in filenames)
+        clock, = conn.execute("SELECT value FROM annotation WHERE name = 'clock'").fetchone()
+        assert clock == "dct.ap_clk"
+        # values are full instance paths, the same as hgdb's JSON conversion produces
+        values = [value for value, in conn.execute("SELECT value FROM variable")]
+        assert not any("$parent" in value for value in values)
+        assert all(any(value.startswith(name + ".") for name in instances) for value in values)
+        rows = conn.execute("SELECT DISTINCT variable.value, instance.name FROM variable "
+                            "JOIN context_variable ON context_variable.variable_id = variable.id "
+                            "JOIN breakpoint ON breakpoint.id = context_variable.breakpoint_id "
+                            "JOIN instance ON instance.id = breakpoint.instance_id").fetchall()
+        # plain variables live in the breakpoint's instance
+        local_values = [value for value, name in rows if value.startswith(name + ".")]
+        assert len(local_values) > 0
+        # $parent variables live in one of its ancestors
+        parent_values = [(value, name) for value, name in rows if not value.startswith(name + ".")]
+        assert len(parent_values) > 0
+        for value, name in parent_values:
+            ancestors = [name[:i] for i in range(len(name)) if name[i] == "."]
+            assert any(value.startswith(ancestor + ".") for ancestor in ancestors)
+        # memory ports live next to the module that uses them, so they are full instance paths
+        rams = [value for value in values if value.endswith(".ram")]
+        assert len(rams) > 0
+        for ram in rams:
+            instance_name = ram[:-len(".ram")].rsplit(".", 1)[0]
+            assert instance_name in instances
+        conn.close()
+
+
+if __name__ == "__main__":
+    test_dct_sqlite()
@@ -0,0 +1,34 @@
+import os
+import tempfile
+
+import vitis
+
+
+def test_state_location():
+    with tempfile.TemporaryDirectory() as temp:
+        with open(os.path.join(temp, "top.xrf"), "w") as f:
+            f.write("""RTL state condition: (1'b1 == ap_CS_fsm_state1)
+    x = 1'<decoy ' <no location ' <src/a.cpp:12> tail
+    ' <src/b.cpp:3> ' <src/c.cpp:4>
+    no quote <src/d.cpp:5>
+RTL state condition: (1'b1 == ap_CS_fsm_state2)
+    ' <src/e.cpp:6>
+""")
+        context = vitis.Context()
+        context["top"] = vitis.ModuleInfo("top")
+        context.top_name = "top"
+        vitis.parse_state_transitions(context, temp, 1)
+
+        states = context["top"].state_infos
+        assert sorted(states.keys()) == ["ap_CS_fsm_state1", "ap_CS_fsm_state2"]
+        # same as '\s<(.*):(\d+)>: the '< without a space is skipped and the greedy file name runs
+        # up to the last location on the line
+        assert states["ap_CS_fsm_state1"].instructions == [
+            ("no location ' <src/a.cpp", 12),
+            ("src/b.cpp:3> ' <src/c.cpp", 4),
+        ]
+        assert states["ap_CS_fsm_state2"].instructions == [("src/e.cpp", 6)]
+
+
+if __name__ == "__main__":
+    test_state_location()